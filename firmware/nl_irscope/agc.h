@@ -0,0 +1,69 @@
+/*
+ * agc.h - single-file header for automatic ranging of the color map
+ * 10-19-26 E. Brombaugh
+ *
+ * Extremes of each frame come from the frame stats and are folded into
+ * smoothed limits after it's rendered, so the map used for a frame comes
+ * from the ones before.
+ * Limits open up quickly and close slowly which keeps the range from pumping
+ * when something hot passes through the field of view.
+ */
+
+#ifndef __agc__
+#define __agc__
+
+#define AGC_ATTACK 1		// IIR shift when range grows
+#define AGC_DECAY 4			// IIR shift when range shrinks
+#define AGC_MINSPAN 8		// raw units (2C) to keep noise from filling the map
+
+int32_t agc_lo, agc_hi;		// smoothed extremes, Q8 raw units
+uint8_t agc_valid;
+
+/*
+ * forget history
+ */
+void agc_init(void)
+{
+	agc_valid = 0;
+}
+
+/*
+ * fold the extremes of the finished frame into the smoothed limits
+ */
+void agc_frame_done(int16_t min, int16_t max)
+{
+	int32_t lo = (int32_t)min << 8, hi = (int32_t)max << 8;
+
+	if(!agc_valid)
+	{
+		/* first frame sets limits directly */
+		agc_lo = lo;
+		agc_hi = hi;
+		agc_valid = 1;
+	}
+	else
+	{
+		agc_lo += (lo - agc_lo) >> ((lo < agc_lo) ? AGC_ATTACK : AGC_DECAY);
+		agc_hi += (hi - agc_hi) >> ((hi > agc_hi) ? AGC_ATTACK : AGC_DECAY);
+	}
+}
+
+/*
+ * compute map base (frac_bits fractional bits) and gain (Q8) that spread the
+ * smoothed limits over the 0-255 color scale
+ */
+void agc_get_map(int16_t *base, uint16_t *gain, uint8_t frac_bits)
+{
+	int16_t lo = agc_lo >> 8, span = (agc_hi - agc_lo) >> 8;
+
+	if(span < AGC_MINSPAN)
+	{
+		/* center the minimum span on the scene */
+		lo -= (AGC_MINSPAN - span)/2;
+		span = AGC_MINSPAN;
+	}
+	*base = lo << frac_bits;
+	*gain = (255<<8) / span;
+}
+
+#endif
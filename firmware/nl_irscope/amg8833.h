@@ -6,20 +6,11 @@
 #ifndef __amg8833__
 #define __amg8833__
 
-// AMG8833 I2C address
-#define AMG8833_I2C_ADDR 0x69
+#include "i2c.h"
 
-// I2C Bus clock rate - must be lower the Logic clock rate
-#define AMG8833_I2C_CLKRATE 100000
-
-// I2C Logic clock rate - must be higher than Bus clock rate
-#define AMG8833_I2C_PRERATE 2000000
-
-// uncomment this for high-speed 36% duty cycle, otherwise 33%
-//#define AMG8833_I2C_DUTY
-
-// I2C Timeout count
-#define TIMEOUT_MAX 100000
+// AMG8833 I2C addresses - AD_SELECT low or high
+#define AMG8833_I2C_ADDR_LO 0x68
+#define AMG8833_I2C_ADDR_HI 0x69
 
 // Register definitions
 #define AMG8833_PCLT 0x00
@@ -58,357 +49,194 @@
 #define AMG8833_INTC_INTMOD_ABS 0x02
 #define AMG8833_INTC_INTEN 0x01
 #define AMG8833_INTC_INTDIS 0x00
+#define AMG8833_AVE_MAMOD 0x20
+#define AMG8833_STAT_INTF 0x02
+#define AMG8833_SCLR_INTCLR 0x02
 
 /*
- * reset and init the I2C port
+ * one sensor on the bus - its address & background array read
  */
-void amg8833_i2c_setup(void)
+typedef struct
 {
-	uint16_t tempreg;
-	
-	// Reset I2C1 to init all regs
-	RCC->APB1PRSTR |= RCC_APB1Periph_I2C1;
-	RCC->APB1PRSTR &= ~RCC_APB1Periph_I2C1;
-	
-	// set freq
-	tempreg = I2C1->CTLR2;
-	tempreg &= ~I2C_CTLR2_FREQ;
-	tempreg |= (FUNCONF_SYSTEM_CORE_CLOCK/AMG8833_I2C_PRERATE)&I2C_CTLR2_FREQ;
-	I2C1->CTLR2 = tempreg;
-	
-	// Set clock config
-	tempreg = 0;
-#if (AMG8833_I2C_CLKRATE <= 100000)
-	// standard mode good to 100kHz
-	tempreg = (FUNCONF_SYSTEM_CORE_CLOCK/(2*AMG8833_I2C_CLKRATE))&I2C_CKCFGR_CCR;
-#else
-	// fast mode over 100kHz
-#ifndef AMG8833_I2C_DUTY
-	// 33% duty cycle
-	tempreg = (FUNCONF_SYSTEM_CORE_CLOCK/(3*AMG8833_I2C_CLKRATE))&I2C_CKCFGR_CCR;
-#else
-	// 36% duty cycle
-	tempreg = (FUNCONF_SYSTEM_CORE_CLOCK/(25*AMG8833_I2C_CLKRATE))&I2C_CKCFGR_CCR;
-	tempreg |= I2C_CKCFGR_DUTY;
-#endif
-	tempreg |= I2C_CKCFGR_FS;
-#endif
-	I2C1->CKCFGR = tempreg;
-	
-	// Enable I2C
-	I2C1->CTLR1 |= I2C_CTLR1_PE;
+	uint8_t addr;		// 7-bit bus address
+	I2C_XFER xfer;		// background array read
+} AMG8833_DEV;
 
-	// set ACK mode
-	I2C1->CTLR1 |= I2C_CTLR1_ACK;
+/*
+ * high-level register write
+ */
+uint8_t amg8833_reg_set(AMG8833_DEV *dev, uint8_t reg, uint8_t data)
+{
+	return i2c_write(dev->addr, reg, &data, 1);
 }
 
 /*
- * event checking
+ * high-level register read single byte
  */
-enum events
+uint8_t amg8833_reg_get(AMG8833_DEV *dev, uint8_t reg, uint8_t *data)
 {
-	NOT_BUSY = 0,
-	MSTR_MODE,
-	TX_MODE,
-	TX_EMPTY,
-	TX_CMPLT,
-	RX_MODE,
-	RX_FULL,
-	RX_CMPLT,
-};
+	return i2c_read(dev->addr, reg, data, 1);
+}
 
 /*
- * event descriptions
+ * high-level register read multi-byte
  */
-char *event_name[] =
+uint8_t amg8833_reg_get_multi(AMG8833_DEV *dev, uint8_t reg, uint8_t *data,
+	uint16_t sz)
 {
-	"not busy",
-	"master mode",
-	"transmit mode",
-	"tx empty",
-	"transmit complete",
-	"receive mode",
-	"rx full",
-	"receive complete",
-};
+	return i2c_read(dev->addr, reg, data, sz);
+}
 
 /*
- * error handler
+ * enable/disable twice moving average output - needs unlock sequence
  */
-uint8_t amg8833_i2c_error(uint8_t evt)
+uint8_t amg8833_set_avg(AMG8833_DEV *dev, uint8_t enable)
 {
-	// report error
-	printf("amg8833_i2c_error - timeout waiting for %s\n\r", event_name[evt]);
-	
-	// reset & initialize I2C
-	amg8833_i2c_setup();
-
-	return 1;
+	if(amg8833_reg_set(dev, AMG8833_SETAVG, 0x50))
+		return 1;
+	if(amg8833_reg_set(dev, AMG8833_SETAVG, 0x45))
+		return 1;
+	if(amg8833_reg_set(dev, AMG8833_SETAVG, 0x57))
+		return 1;
+	if(amg8833_reg_set(dev, AMG8833_AVE, enable ? AMG8833_AVE_MAMOD : 0))
+		return 1;
+	return amg8833_reg_set(dev, AMG8833_SETAVG, 0x00);
 }
 
-// event codes we use
-#define  AMG8833_I2C_EVENT_MASTER_MODE_SELECT ((uint32_t)0x00030001)  /* BUSY, MSL and SB flag */
-#define  AMG8833_I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED ((uint32_t)0x00070082)  /* BUSY, MSL, ADDR, TXE and TRA flags */
-#define  AMG8833_I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED ((uint32_t)0x00030002)  /* BUSY, MSL and ADDR flags */
-#define  AMG8833_I2C_EVENT_MASTER_BYTE_TRANSMITTED ((uint32_t)0x00070084)  /* TRA, BUSY, MSL, TXE and BTF flags */
-#define  AMG8833_I2C_EVENT_MASTER_BYTE_RECEIVED ((uint32_t)0x00030040)  /* BUSY, MSL and RXNE flags */
-
 /*
- * check for 32-bit event codes
+ * high-level read thermistor value
  */
-uint8_t amg8833_i2c_chk_evt(uint32_t event_mask)
+uint8_t amg8833_get_thermistor(AMG8833_DEV *dev, uint16_t *temp)
 {
-	/* read order matters here! STAR1 before STAR2!! */
-	uint32_t status = I2C1->STAR1 | (I2C1->STAR2<<16);
-	return (status & event_mask) == event_mask;
+	return amg8833_reg_get_multi(dev, AMG8833_TTHL, (uint8_t *)temp, 2);
 }
 
 /*
- * low-level packet send for blocking polled operation via i2c
+ * write a 12-bit signed value in raw units to a low/high register pair
  */
-uint8_t amg8833_i2c_send(uint8_t addr, uint8_t *data, uint8_t sz)
+uint8_t amg8833_reg_set12(AMG8833_DEV *dev, uint8_t reg, int16_t val)
 {
-	int32_t timeout;
-	
-	// wait for not busy
-	timeout = TIMEOUT_MAX;
-	while((I2C1->STAR2 & I2C_STAR2_BUSY) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(NOT_BUSY);
-
-	// Set START condition
-	I2C1->CTLR1 |= I2C_CTLR1_START;
-	
-	// wait for master mode select
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_MODE_SELECT)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(MSTR_MODE);
-	
-	// send 7-bit address + write flag
-	I2C1->DATAR = addr<<1;
-
-	// wait for receive condition
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(TX_MODE);
-
-	// send data one byte at a time
-	while(sz--)
-	{
-		// wait for TX Empty
-		timeout = TIMEOUT_MAX;
-		while(!(I2C1->STAR1 & I2C_STAR1_TXE) && (timeout--));
-		if(timeout==-1)
-			return amg8833_i2c_error(TX_EMPTY);
-		
-		// send command
-		I2C1->DATAR = *data++;
-	}
-
-	// wait for tx complete
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_BYTE_TRANSMITTED)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(TX_CMPLT);
-
-	// set STOP condition
-	I2C1->CTLR1 |= I2C_CTLR1_STOP;
-	
-	// we're happy
-	return 0;
+	if(amg8833_reg_set(dev, reg, val & 0xff))
+		return 1;
+	return amg8833_reg_set(dev, reg+1, (val >> 8) & 0x0f);
 }
 
 /*
- * high-level register write
+ * start/stop watching for any element changing by more than delta raw units
+ * (0.25C) between sensor frames using the pixel interrupt logic
  */
-uint8_t amg8833_reg_set(uint8_t reg, uint8_t data)
+uint8_t amg8833_watch(AMG8833_DEV *dev, uint8_t enable, int16_t delta)
 {
-	uint8_t packet[2];
+	if(!enable)
+		return amg8833_reg_set(dev, AMG8833_INTC, AMG8833_INTC_INTDIS);
 	
-	packet[0] = reg;
-	packet[1] = data;
-	return amg8833_i2c_send(AMG8833_I2C_ADDR, packet, 2);
+	// difference mode thresholds with half as much hysteresis
+	if(amg8833_reg_set12(dev, AMG8833_INTHL, delta))
+		return 1;
+	if(amg8833_reg_set12(dev, AMG8833_INTLL, -delta))
+		return 1;
+	if(amg8833_reg_set12(dev, AMG8833_INTSL, delta/2))
+		return 1;
+	if(amg8833_reg_set(dev, AMG8833_SCLR, AMG8833_SCLR_INTCLR))
+		return 1;
+	return amg8833_reg_set(dev, AMG8833_INTC, AMG8833_INTC_INTEN);
 }
 
 /*
- * low-level Register read for blocking polled operation via i2c
+ * check the interrupt flag - returns TRUE if any element fired, with one
+ * bit per element in the 8-byte table, and re-arms
  */
-uint8_t amg8833_i2c_reg_receive(uint8_t addr, uint reg, uint8_t *data, uint8_t sz)
+uint8_t amg8833_watch_check(AMG8833_DEV *dev, uint8_t *table)
 {
-	int32_t timeout;
-	
-	// wait for not busy
-	timeout = TIMEOUT_MAX;
-	while((I2C1->STAR2 & I2C_STAR2_BUSY) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(NOT_BUSY);
-
-	// Set START condition
-	I2C1->CTLR1 |= I2C_CTLR1_START;
-	
-	// wait for master mode select
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_MODE_SELECT)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(MSTR_MODE);
-	
-	// send 7-bit address + write flag
-	I2C1->DATAR = addr<<1;
-
-	// wait for transmit condition
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(TX_MODE);
-
-	// wait for TX Empty
-	timeout = TIMEOUT_MAX;
-	while(!(I2C1->STAR1 & I2C_STAR1_TXE) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(TX_EMPTY);
-	
-	// send register address
-	I2C1->DATAR = reg;
-	
-	// wait for tx complete
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_BYTE_TRANSMITTED)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(TX_CMPLT);
-
-	// Set repeated START condition
-	I2C1->CTLR1 |= I2C_CTLR1_START;
-	
-	// wait for master mode select
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_MODE_SELECT)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(MSTR_MODE);
+	uint8_t stat;
 	
-	// send 7-bit address + read flag
-	I2C1->DATAR = addr<<1 | 1;
-
-	// wait for receive condition
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(RX_MODE);
-
-	// receive data one byte at a time
-	while(sz--)
-	{
-		// wait for RX Full
-		timeout = TIMEOUT_MAX;
-		while(!(I2C1->STAR1 & I2C_STAR1_RXNE) && (timeout--))
-			if(!sz)
-				I2C1->CTLR1 &= CTLR1_ACK_Reset;	// no ack on last byte
-			else
-				I2C1->CTLR1 |= CTLR1_ACK_Set;	// ack on intermediate bytes
-
-		if(timeout==-1)
-			return amg8833_i2c_error(RX_FULL);
-		
-		// receive data
-		*data++ = I2C1->DATAR;
-	}
-
-#if 0
-	// this times out - doesn't seem to be needed based on example code
-	// wait for rx complete
-	timeout = TIMEOUT_MAX;
-	while((!amg8833_i2c_chk_evt(AMG8833_I2C_EVENT_MASTER_BYTE_RECEIVED)) && (timeout--));
-	if(timeout==-1)
-		return amg8833_i2c_error(RX_CMPLT);
-#endif
-	
-	// set STOP condition
-	I2C1->CTLR1 |= I2C_CTLR1_STOP;
-	
-	// we're happy
-	return 0;
+	if(amg8833_reg_get(dev, AMG8833_STAT, &stat) || !(stat & AMG8833_STAT_INTF))
+		return 0;
+	if(amg8833_reg_get_multi(dev, AMG8833_INT0, table, 8))
+		return 0;
+	amg8833_reg_set(dev, AMG8833_SCLR, AMG8833_SCLR_INTCLR);
+	return 1;
 }
 
 /*
- * high-level register read single byte
+ * queue reading array values in the background - returns 1 if the bus
+ * queue is full, amg8833_xfer_pending() goes FALSE when finished
  */
-uint8_t amg8833_i2c_reg_get(uint8_t reg, uint8_t *data)
+uint8_t amg8833_get_array_start(AMG8833_DEV *dev, uint16_t *array)
 {
-	return amg8833_i2c_reg_receive(AMG8833_I2C_ADDR, reg, data, 1);
+	dev->xfer.addr = dev->addr;
+	dev->xfer.reg = AMG8833_T01L;
+	dev->xfer.dir = I2C_READ;
+	dev->xfer.buf = (uint8_t *)array;
+	dev->xfer.len = 128;
+	dev->xfer.callback = NULL;
+	return i2c_submit(&dev->xfer);
 }
 
 /*
- * high-level register read multi-byte
+ * returns TRUE while the background read is waiting or running
  */
-uint8_t amg8833_i2c_reg_get_multi(uint8_t reg, uint8_t *data, uint16_t sz)
+uint8_t amg8833_xfer_pending(AMG8833_DEV *dev)
 {
-	return amg8833_i2c_reg_receive(AMG8833_I2C_ADDR, reg, data, sz);
+	return i2c_pending(&dev->xfer);
 }
 
 /*
- * high-level read thermistor value
+ * rows of 8 array values available from the background read so far - all
+ * of them once it has finished, none more if it failed
  */
-uint8_t amg8833_get_thermistor(uint16_t *temp)
+uint8_t amg8833_array_rows(AMG8833_DEV *dev)
 {
-	return amg8833_i2c_reg_receive(AMG8833_I2C_ADDR, AMG8833_TTHL, (uint8_t *)temp, 2);
+	if(!amg8833_xfer_pending(dev))
+		return dev->xfer.status == I2C_DONE ? 8 : 0;
+	return i2c_rx_count(&dev->xfer) >> 4;
 }
 
 /*
  * high-level read array values
  */
-uint8_t amg8833_get_array(uint16_t *array)
+uint8_t amg8833_get_array(AMG8833_DEV *dev, uint16_t *array)
 {
-	return amg8833_i2c_reg_receive(AMG8833_I2C_ADDR, AMG8833_T01L, (uint8_t *)array, 128);
+	return amg8833_reg_get_multi(dev, AMG8833_T01L, (uint8_t *)array, 128);
 }
 
 /*
- * init the GPIO port, init the I2C port and prep the sensor
+ * init the I2C bus and prep the sensor at addr
  */
-uint8_t amg8833_init(void)
+uint8_t amg8833_init(AMG8833_DEV *dev, uint8_t addr)
 {
-	// Enable GPIOC and I2C
-	RCC->APB1PCENR |= RCC_APB1Periph_I2C1;
-	RCC->APB2PCENR |= RCC_APB2Periph_GPIOC | RCC_APB2Periph_AFIO;
-
-	// PC1 is SDA, 10MHz Output, alt func, open-drain
-	GPIOC->CFGLR &= ~(0xf<<(4*1));
-	GPIOC->CFGLR |= (GPIO_Speed_10MHz | GPIO_CNF_OUT_OD_AF)<<(4*1);
-	
-	// PC2 is SCL, 10MHz Output, alt func, open-drain
-	GPIOC->CFGLR &= ~(0xf<<(4*2));
-	GPIOC->CFGLR |= (GPIO_Speed_10MHz | GPIO_CNF_OUT_OD_AF)<<(4*2);
+	dev->addr = addr;
 
-	// init the I2C port
-	amg8833_i2c_setup();
+	// init the I2C bus
+	i2c_init();
 	
 #if 0
 	// test loop for HW debug
 	while(1)
 	{
-		amg8833_reg_set(0, 0);
+		amg8833_reg_set(dev, 0, 0);
 		Delay_Ms(1);
 	}
 #endif
 	
 	// Set sensor to normal power mode
 	printf("amg8833_init: normal power\n\r");
-	if(amg8833_reg_set(AMG8833_PCLT, AMG8833_PCLT_NORM))
+	if(amg8833_reg_set(dev, AMG8833_PCLT, AMG8833_PCLT_NORM))
 		return 1;
 	
 	// Initial reset
 	printf("amg8833_init: initial reset\n\r");
-	if(amg8833_reg_set(AMG8833_RST, AMG8833_RST_INIT))
+	if(amg8833_reg_set(dev, AMG8833_RST, AMG8833_RST_INIT))
 		return 1;
 	
 	// Disable interrupts
 	printf("amg8833_init: disable IRQs\n\r");
-	if(amg8833_reg_set(AMG8833_INTC, AMG8833_INTC_INTDIS))
+	if(amg8833_reg_set(dev, AMG8833_INTC, AMG8833_INTC_INTDIS))
 		return 1;
 	
 	// 10FPS
 	printf("amg8833_init: 10FPS\n\r");
-	if(amg8833_reg_set(AMG8833_FPSC, AMG8833_FPSC_10HZ))
+	if(amg8833_reg_set(dev, AMG8833_FPSC, AMG8833_FPSC_10HZ))
 		return 1;
 
 	// we're happy
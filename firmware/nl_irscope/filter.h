@@ -0,0 +1,80 @@
+/*
+ * filter.h - single-file header for per-element temporal noise filter
+ * 10-19-26 E. Brombaugh
+ *
+ * First-order IIR per element with state kept in Q4. Steps larger than
+ * FILT_BYPASS are taken immediately so moving objects don't smear.
+ * Rows are filtered as they arrive but the state only moves once the whole
+ * frame has been accepted, so a repeated frame leaves no trace.
+ */
+
+#ifndef __filter__
+#define __filter__
+
+#define FILT_FRAC 4			// fraction bits in state
+#define FILT_BYPASS 8		// raw units (2C) of change that skip the filter
+#define FILT_JUMP -128		// step marking an element that skipped the filter
+
+int16_t filt_acc[64];
+int8_t filt_step[64];		// pending move of the state, within +/-FILT_BYPASS
+uint8_t filt_valid, filt_ready;
+
+/*
+ * forget history
+ */
+void filt_init(void)
+{
+	filt_valid = 0;
+	filt_ready = 0;
+}
+
+/*
+ * filter n elements in place starting at element first of the frame - time
+ * constant is 2^shift frames, the steps are ready once the last one is done
+ */
+void filt_elems(int16_t *ir, uint8_t first, uint8_t n, uint8_t shift)
+{
+	int16_t diff, acc;
+	uint8_t i;
+
+	for(i=first;i<first+n;i++)
+	{
+		diff = (ir[i]<<FILT_FRAC) - filt_acc[i];
+		if(!filt_valid || (diff > (FILT_BYPASS<<FILT_FRAC)) ||
+			(diff < -(FILT_BYPASS<<FILT_FRAC)))
+		{
+			acc = ir[i]<<FILT_FRAC;
+			filt_step[i] = FILT_JUMP;
+		}
+		else
+		{
+			filt_step[i] = diff >> shift;
+			acc = filt_acc[i] + filt_step[i];
+		}
+
+		/* round back to raw units */
+		ir[i] = (acc + (1<<(FILT_FRAC-1))) >> FILT_FRAC;
+	}
+	filt_ready = (i == 64);
+}
+
+/*
+ * the filtered frame in ir has been accepted - move the state on to it
+ */
+void filt_frame_done(int16_t *ir)
+{
+	uint8_t i;
+
+	if(!filt_ready)
+		return;
+
+	for(i=0;i<64;i++)
+		if(filt_step[i] == FILT_JUMP)
+			filt_acc[i] = ir[i]<<FILT_FRAC;
+		else
+			filt_acc[i] += filt_step[i];
+	filt_valid = 1;
+	filt_ready = 0;
+}
+
+#endif
@@ -10,6 +10,10 @@
 #include <string.h>
 #include "font_8x8.h"
 
+// characters in the font, others are drawn as '?'
+#define GFX_FONT_FIRST 0x20
+#define GFX_FONT_LAST 0x7e
+
 // Color definitions
 #define GFX_BLACK   0x00000000
 #define GFX_BLUE    0x000000FF
@@ -36,6 +40,20 @@ enum gfx_txtmodes
 	GFX_TXTREV = 0x80,
 };
 
+/*
+ * orientation flags for gfx_bitblt_orient - transpose first, then mirror
+ */
+enum gfx_orient
+{
+	GFX_ORIENT_NORM = 0,
+	GFX_ORIENT_MIRX = 0x01,		// mirror left/right
+	GFX_ORIENT_MIRY = 0x02,		// mirror top/bottom
+	GFX_ORIENT_XY = 0x04,		// buffer rows become screen columns
+	GFX_ORIENT_ROT90 = GFX_ORIENT_XY | GFX_ORIENT_MIRX,		// clockwise
+	GFX_ORIENT_ROT180 = GFX_ORIENT_MIRX | GFX_ORIENT_MIRY,
+	GFX_ORIENT_ROT270 = GFX_ORIENT_XY | GFX_ORIENT_MIRY,
+};
+
 typedef uint32_t GFX_COLOR;
 
 /*
@@ -53,6 +71,10 @@ typedef struct
 		uint16_t color);
 	void (*drawPixel)(int16_t x, int16_t y, uint16_t color);
 	void (*bitblt)(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *buf);
+	void (*bitblt_idx)(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t *buf,
+		uint8_t bpp, const uint16_t *pal);
+	void (*bitblt_orient)(int16_t x, int16_t y, int16_t w, int16_t h,
+		uint16_t *buf, uint8_t orient);
 } GFX_DRIVER;
 
 typedef struct
@@ -69,6 +91,24 @@ typedef struct
 	int16_t y1;
 } GFX_RECT;
 
+/*
+ * strip chart - sweeps left to right one column per sample, ring buffer
+ * holds the plotted row of each column so only new columns are drawn
+ */
+#define GFX_CHART_TRACES 2
+#define GFX_CHART_EMPTY 0xff
+
+typedef struct
+{
+	GFX_RECT rect;							// area on screen, max 64 high
+	int16_t vmin, vmax;						// values at bottom & top
+	uint8_t *samp[GFX_CHART_TRACES];		// ring of rows, one per column
+	uint16_t color[GFX_CHART_TRACES];		// native trace colors
+	uint16_t marker;						// native sweep marker color
+	uint8_t ntraces;
+	uint8_t head;							// column of next sample
+} GFX_CHART;
+
 const GFX_COLOR gfx_colortab[16] =
 {
 	GFX_BLACK,
@@ -88,11 +128,10 @@ const GFX_COLOR gfx_colortab[16] =
 	GFX_WHITE,
 };
 
-GFX_DRIVER *gfxdrv;
+const GFX_DRIVER *gfxdrv;
 GFX_COLOR forecolor, backcolor;
 uint8_t txtsz, txtmode;
-uint16_t gfx_chrbuff[2][64];	// double buffered in case of DMA
-uint8_t gfx_chrbuffidx;
+uint16_t gfx_chrbuff[64];		// the driver is done with it on return
 
 /*
  * abs() helper function for line drawing
@@ -177,9 +216,9 @@ void gfx_clrpixel(GFX_POINT pixel)
 }
 
 /*
- * fill a rectangle with color
+ * fill a rectangle with native 16-bit color
  */
-void gfx_colorrect(GFX_RECT *rect, GFX_COLOR color)
+void gfx_rawrect(GFX_RECT *rect, uint16_t rawcolor)
 {
 	/* check for inversion */
 	if(rect->x0 > rect->x1)
@@ -187,18 +226,24 @@ void gfx_colorrect(GFX_RECT *rect, GFX_COLOR color)
 	if(rect->y0 > rect->y1)
 		gfx_swap(&rect->y0, &rect->y1);
 	
-	uint16_t rawcolor = gfxdrv->Color565(color);
-
 	gfxdrv->fillRect(rect->x0, rect->y0, rect->x1-rect->x0+1, rect->y1-rect->y0+1,
 		rawcolor);
 }
 
+/*
+ * fill a rectangle with color
+ */
+void gfx_colorrect(GFX_RECT *rect, GFX_COLOR color)
+{
+	gfx_rawrect(rect, gfxdrv->Color565(color));
+}
+
 /*
  * fill a rectangle with foreground
  */
 void gfx_fillrect(GFX_RECT *rect)
 {
-	gfx_colorrect(rect, forecolor);
+	gfx_rawrect(rect, forecolor);
 }
 
 /*
@@ -206,7 +251,7 @@ void gfx_fillrect(GFX_RECT *rect)
  */
 void gfx_clrrect(GFX_RECT *rect)
 {
-	gfx_colorrect(rect, backcolor);
+	gfx_rawrect(rect, backcolor);
 }
 
 /*
@@ -387,6 +432,16 @@ void gfx_set_txtmode(uint8_t mode)
 	txtmode = mode;
 }
 
+/*
+ * font rows of a character
+ */
+static inline const uint8_t *gfx_glyph(uint8_t chr)
+{
+	if((chr < GFX_FONT_FIRST) || (chr > GFX_FONT_LAST))
+		chr = '?';
+	return &fontdata[(chr-GFX_FONT_FIRST)<<3];
+}
+
 /*
  * Draw character direct to the display at 1x scale
  */
@@ -395,14 +450,15 @@ void gfx_drawchar_1x(int16_t x, int16_t y, uint8_t chr)
     int16_t xt, yt;
 	uint16_t i, j;
 	uint8_t d;
-	uint16_t *gptr = gfx_chrbuff[gfx_chrbuffidx];
+	uint16_t *gptr = gfx_chrbuff;
+	const uint8_t *glyph = gfx_glyph(chr);
 
     yt = y;
 
 	/* convert font bitmap to colored glyph */
 	for(i=0;i<8;i++)
 	{
-		d = fontdata[(chr<<3)+i];
+		d = glyph[i];
         xt = x;
 		for(j=0;j<8;j++)
 		{
@@ -450,8 +506,7 @@ void gfx_drawchar_1x(int16_t x, int16_t y, uint8_t chr)
 	}
 	
     /* render to LCD */
-	gfxdrv->bitblt(x, y, xt, yt, gfx_chrbuff[gfx_chrbuffidx]);
-	gfx_chrbuffidx ^= 1;
+	gfxdrv->bitblt(x, y, xt, yt, gfx_chrbuff);
 }
 
 /*
@@ -462,13 +517,14 @@ void gfx_drawchar_xx(int16_t x, int16_t y, uint8_t chr)
     int16_t xt, yt;
 	uint16_t i, j;
 	uint8_t d;
+	const uint8_t *glyph = gfx_glyph(chr);
 
     yt = y;
 
 	/* convert font bitmap to colored glyph */
 	for(i=0;i<8;i++)
 	{
-		d = fontdata[(chr<<3)+i];
+		d = glyph[i];
         xt = x;
 		for(j=0;j<8;j++)
 		{
@@ -574,6 +630,135 @@ void gfx_bitblt(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *buf)
 	gfxdrv->bitblt(x, y, w, h, buf);
 }
 
+/*
+ * block transfer of 1/2/4/8 bpp palette indices - rows are padded to whole
+ * bytes, leftmost pixel in the MSBs. Palette holds native colors as returned
+ * by gfx_getcolor() so expansion happens on the fly.
+ */
+void gfx_bitblt_idx(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t *buf,
+	uint8_t bpp, const uint16_t *pal)
+{
+	gfxdrv->bitblt_idx(x, y, w, h, buf, bpp, pal);
+}
+
+/*
+ * block transfer rotated / mirrored by the display controller - buf is w x h
+ * in natural order, occupies h x w on screen when GFX_ORIENT_XY is set.
+ */
+void gfx_bitblt_orient(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *buf,
+	uint8_t orient)
+{
+	gfxdrv->bitblt_orient(x, y, w, h, buf, orient);
+}
+
+/*
+ * render one chart column to the display in a single transfer
+ */
+void gfx_chart_column(GFX_CHART *chart, uint8_t col)
+{
+	int16_t h = chart->rect.y1 - chart->rect.y0 + 1;
+	uint16_t *gptr = gfx_chrbuff;
+	uint8_t t, r, r0, r1;
+	
+	/* clear column to background */
+	for(r=0;r<h;r++)
+		gptr[r] = backcolor;
+	
+	/* each trace is a vertical run joining the previous column */
+	for(t=0;t<chart->ntraces;t++)
+	{
+		r0 = r1 = chart->samp[t][col];
+		if(r0 == GFX_CHART_EMPTY)
+			continue;
+		if(col && (chart->samp[t][col-1] != GFX_CHART_EMPTY))
+			r0 = chart->samp[t][col-1];
+		if(r0 > r1)
+		{
+			r = r0;
+			r0 = r1;
+			r1 = r;
+		}
+		for(r=r0;r<=r1;r++)
+			gptr[r] = chart->color[t];
+	}
+	
+	gfxdrv->bitblt(chart->rect.x0 + col, chart->rect.y0, 1, h, gptr);
+}
+
+/*
+ * redraw the whole chart from the ring buffer
+ */
+void gfx_chart_redraw(GFX_CHART *chart)
+{
+	uint8_t col, w = chart->rect.x1 - chart->rect.x0 + 1;
+	
+	for(col=0;col<w;col++)
+		gfx_chart_column(chart, col);
+	
+	/* sweep marker */
+	gfxdrv->fillRect(chart->rect.x0 + chart->head, chart->rect.y0, 1,
+		chart->rect.y1 - chart->rect.y0 + 1, chart->marker);
+}
+
+/*
+ * set up a chart - buf must hold ntraces * width bytes
+ */
+void gfx_chart_init(GFX_CHART *chart, GFX_RECT *rect, int16_t vmin, int16_t vmax,
+	uint8_t ntraces, uint8_t *buf)
+{
+	uint8_t t, w = rect->x1 - rect->x0 + 1;
+	
+	memcpy(&chart->rect, rect, sizeof(GFX_RECT));
+	chart->vmin = vmin;
+	chart->vmax = vmax;
+	chart->ntraces = ntraces > GFX_CHART_TRACES ? GFX_CHART_TRACES : ntraces;
+	for(t=0;t<chart->ntraces;t++)
+	{
+		chart->samp[t] = buf + t*w;
+		memset(chart->samp[t], GFX_CHART_EMPTY, w);
+		chart->color[t] = forecolor;
+	}
+	chart->marker = gfxdrv->Color565(GFX_DGRAY);
+	chart->head = 0;
+	
+	gfx_chart_redraw(chart);
+}
+
+/*
+ * set color of one trace
+ */
+void gfx_chart_color(GFX_CHART *chart, uint8_t trace, GFX_COLOR color)
+{
+	if(trace < chart->ntraces)
+		chart->color[trace] = gfxdrv->Color565(color);
+}
+
+/*
+ * add one sample per trace - draws the new column and moves the marker
+ */
+void gfx_chart_add(GFX_CHART *chart, int16_t *vals)
+{
+	uint8_t t, w = chart->rect.x1 - chart->rect.x0 + 1;
+	int16_t h = chart->rect.y1 - chart->rect.y0, row;
+	
+	/* scale to rows, top is row 0 */
+	for(t=0;t<chart->ntraces;t++)
+	{
+		row = vals[t] < chart->vmin ? chart->vmin : vals[t];
+		row = row > chart->vmax ? chart->vmax : row;
+		row = h - ((int32_t)(row - chart->vmin) * h) / (chart->vmax - chart->vmin);
+		chart->samp[t][chart->head] = row;
+	}
+	
+	/* new data replaces the old marker */
+	gfx_chart_column(chart, chart->head);
+	
+	/* advance & mark the next (oldest) column */
+	chart->head = chart->head+1 >= w ? 0 : chart->head+1;
+	gfxdrv->fillRect(chart->rect.x0 + chart->head, chart->rect.y0, 1, h+1,
+		chart->marker);
+}
+
 /*
  * Convert HSV triple to RGB triple
  * use algorithm from
@@ -661,7 +846,7 @@ GFX_COLOR gfx_hsv2rgb(uint8_t hsv[])
 /*
  * initialize display
  */
-void gfx_init(GFX_DRIVER *drvr)
+void gfx_init(const GFX_DRIVER *drvr)
 {
 	gfxdrv = drvr;
 
@@ -671,7 +856,6 @@ void gfx_init(GFX_DRIVER *drvr)
 	backcolor = gfxdrv->Color565(GFX_BLACK);
 	txtsz = 1;
 	txtmode = GFX_TXTNORM;
-	gfx_chrbuffidx = 0;
 	gfx_clrscreen();
 }
-#endif
\ No newline at end of file
+#endif
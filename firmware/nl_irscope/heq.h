@@ -0,0 +1,69 @@
+/*
+ * heq.h - single-file header for histogram equalized color map
+ * 10-19-26 E. Brombaugh
+ *
+ * One bin per raw unit (0.25C) starting at the coldest element, so a frame
+ * spanning only a couple of degrees still has every level separated. The
+ * map is the mid-point rank of each level, and with 64 elements the rank
+ * scales to 0-255 with a shift instead of a divide. The coldest element
+ * comes from the frame stats, leaving a fixed cost of two 64-step loops
+ * per frame. The histogram is turned into the map in place, so the state is
+ * 66 bytes.
+ */
+
+#ifndef __heq__
+#define __heq__
+
+#define HEQ_BINS 64		// bins above the frame minimum, top one collects the rest
+
+uint8_t heq_lut[HEQ_BINS];		// histogram until it's mapped
+int16_t heq_base;
+
+/*
+ * build histogram and map for a 64-element frame with its coldest element
+ */
+void heq_build(int16_t *ir, int16_t min)
+{
+	uint8_t i, n, cdf;
+	int16_t bin;
+
+	/* bins start at coldest element */
+	heq_base = min;
+
+	/* histogram */
+	memset(heq_lut, 0, HEQ_BINS);
+	for(i=0;i<64;i++)
+	{
+		bin = ir[i] - heq_base;
+		bin = bin >= HEQ_BINS ? HEQ_BINS-1 : bin;
+		heq_lut[bin]++;
+	}
+
+	/* map each level to its mid-point rank: (2*below + count) / 128 */
+	cdf = 0;
+	for(i=0;i<HEQ_BINS;i++)
+	{
+		n = heq_lut[i];
+		heq_lut[i] = ((uint16_t)(2*cdf + n) * 255) >> 7;
+		cdf += n;
+	}
+}
+
+/*
+ * map value with frac_bits fraction bits to color scale, interpolating
+ * between levels so upscaled images stay smooth
+ */
+uint8_t heq_scale(int16_t ir, uint8_t frac_bits)
+{
+	int16_t rel = ir - (heq_base << frac_bits), bin, frac;
+
+	if(rel <= 0)
+		return heq_lut[0];
+	bin = rel >> frac_bits;
+	if(bin >= HEQ_BINS-1)
+		return heq_lut[HEQ_BINS-1];
+	frac = rel & ((1<<frac_bits)-1);
+	return heq_lut[bin] + (((heq_lut[bin+1] - heq_lut[bin]) * frac) >> frac_bits);
+}
+
+#endif
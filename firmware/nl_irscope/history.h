@@ -0,0 +1,218 @@
+/*
+ * history.h - single-file header for the frame history ring
+ * 10-19-26 E. Brombaugh
+ *
+ * Recent frames are kept as deltas from the frame before, packed a nibble
+ * per element since most elements only move a few LSBs between frames.
+ * Larger steps escape to the full 16-bit value. The oldest frame is held
+ * whole as the base that the deltas build on, and the newest is kept whole
+ * to encode the next one against. Everything lives in the SRAM between the
+ * end of .bss and the stack, so the ring grows or shrinks with the rest of
+ * the firmware. The SRAM budget leaves it at least HIST_MIN bytes, enough
+ * for both whole frames and a worst case record, which nl_irscope.ld checks
+ * at link time.
+ */
+
+#ifndef __history__
+#define __history__
+
+#define HIST_STACK 512				// bytes left below the stack top
+#define HIST_ESC 0x8				// nibble that escapes to a full value
+#define HIST_DMAX 7					// largest delta held in one nibble
+#define HIST_REC_MAX (1+(64*5+1)/2)	// length byte + every element escaped
+#define HIST_MIN 448				// smallest block left between .bss & stack
+
+/* linker script symbols */
+extern uint8_t _ebss[], _eusrstack[];
+
+uint8_t *hist_ring;
+int16_t *hist_base, *hist_last;		// oldest & newest frames
+uint16_t hist_size, hist_head, hist_tail, hist_used;
+uint8_t hist_frames;				// frames held, counting the base
+
+/* nibble packing state */
+typedef struct
+{
+	uint16_t p;						// ring offset of the next byte
+	uint8_t byte, odd;
+} HIST_PACK;
+
+/*
+ * carve the ring & both whole frames from a block of memory
+ */
+void hist_setup(uint8_t *mem, uint16_t size)
+{
+	hist_frames = 0;
+	hist_head = hist_tail = hist_used = 0;
+	hist_size = 0;
+	if(size < 2*64*sizeof(int16_t) + HIST_REC_MAX)
+		return;
+
+	hist_base = (int16_t *)mem;
+	hist_last = hist_base + 64;
+	hist_ring = (uint8_t *)(hist_last + 64);
+	hist_size = size - 2*64*sizeof(int16_t);
+}
+
+/*
+ * use whatever SRAM is free above .bss
+ */
+void hist_init(void)
+{
+	uintptr_t start = ((uintptr_t)_ebss + 3) & ~3;
+	uintptr_t end = (uintptr_t)_eusrstack - HIST_STACK;
+
+	hist_setup((uint8_t *)start, end > start ? end - start : 0);
+}
+
+/*
+ * ring offset one past p
+ */
+static inline uint16_t hist_next(uint16_t p)
+{
+	return ++p == hist_size ? 0 : p;
+}
+
+/*
+ * append a nibble
+ */
+void hist_put(HIST_PACK *pk, uint8_t n)
+{
+	if(!pk->odd)
+		pk->byte = n;
+	else
+	{
+		hist_ring[pk->p] = pk->byte | (n << 4);
+		pk->p = hist_next(pk->p);
+	}
+	pk->odd ^= 1;
+}
+
+/*
+ * fetch a nibble
+ */
+uint8_t hist_get(HIST_PACK *pk)
+{
+	if(!pk->odd)
+	{
+		pk->byte = hist_ring[pk->p];
+		pk->p = hist_next(pk->p);
+	}
+	pk->odd ^= 1;
+	return pk->odd ? pk->byte & 0xf : pk->byte >> 4;
+}
+
+/*
+ * apply the record at *p to frame f & step *p past it
+ */
+void hist_decode(uint16_t *p, int16_t *f)
+{
+	HIST_PACK pk = {hist_next(*p), 0, 0};
+	uint16_t len = hist_ring[*p];
+	uint8_t i, n;
+
+	for(i=0;i<64;i++)
+	{
+		n = hist_get(&pk);
+		if(n == HIST_ESC)
+		{
+			f[i] = hist_get(&pk);
+			f[i] |= hist_get(&pk) << 4;
+			f[i] |= hist_get(&pk) << 8;
+			f[i] |= hist_get(&pk) << 12;
+		}
+		else
+			f[i] += (int8_t)(n ^ 8) - 8;
+	}
+
+	*p += len + 1;
+	*p = *p >= hist_size ? *p - hist_size : *p;
+}
+
+/*
+ * drop the oldest frame - the next one becomes the base
+ */
+void hist_drop(void)
+{
+	uint16_t len = hist_ring[hist_tail] + 1;
+
+	hist_decode(&hist_tail, hist_base);
+	hist_used -= len;
+	hist_frames--;
+}
+
+/*
+ * add a frame to the ring, dropping old ones to make room
+ */
+void hist_add(int16_t *ir)
+{
+	HIST_PACK pk;
+	uint16_t len;
+	int16_t d;
+	uint8_t i;
+
+	if(!hist_size)
+		return;
+
+	/* first frame is the base */
+	if(!hist_frames)
+	{
+		memcpy(hist_base, ir, 64*sizeof(int16_t));
+		memcpy(hist_last, ir, 64*sizeof(int16_t));
+		hist_frames = 1;
+		return;
+	}
+
+	/* make room for exactly this record, counting its escapes first */
+	len = 1 + 64/2;
+	for(i=0;i<64;i++)
+	{
+		d = ir[i] - hist_last[i];
+		if((d < -HIST_DMAX) || (d > HIST_DMAX))
+			len += 2;
+	}
+	while((hist_size - hist_used < len) || (hist_frames == 255))
+		hist_drop();
+
+	/* length byte is filled in when the size is known */
+	pk.p = hist_next(hist_head);
+	pk.odd = 0;
+	for(i=0;i<64;i++)
+	{
+		d = ir[i] - hist_last[i];
+		if((d >= -HIST_DMAX) && (d <= HIST_DMAX))
+			hist_put(&pk, d & 0xf);
+		else
+		{
+			hist_put(&pk, HIST_ESC);
+			hist_put(&pk, ir[i] & 0xf);
+			hist_put(&pk, (ir[i] >> 4) & 0xf);
+			hist_put(&pk, (ir[i] >> 8) & 0xf);
+			hist_put(&pk, (ir[i] >> 12) & 0xf);
+		}
+		hist_last[i] = ir[i];
+	}
+	if(pk.odd)
+		hist_put(&pk, 0);
+
+	d = pk.p - hist_head - 1;
+	d = d < 0 ? d + hist_size : d;
+	hist_ring[hist_head] = d;
+	hist_head = pk.p;
+	hist_used += d + 1;
+	hist_frames++;
+}
+
+/*
+ * rebuild frame k, 0 being the oldest
+ */
+void hist_frame(uint8_t k, int16_t *f)
+{
+	uint16_t p = hist_tail;
+
+	memcpy(f, hist_base, 64*sizeof(int16_t));
+	while(k--)
+		hist_decode(&p, f);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * bench.h - host clock for the benchmarks
+ * 10-19-26 E. Brombaugh
+ *
+ * The TSC on x86, otherwise nanoseconds. Host figures only compare versions
+ * of a routine - the RV32EC has no multiplier or divider, so on-target
+ * numbers come from building nl_irscope.c with BENCH defined.
+ */
+
+#ifndef __bench__
+#define __bench__
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t bench_clocks(void)
+{
+	return __rdtsc();
+}
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t bench_clocks(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+#endif
+
+/* best of several runs of n frames each, to skip interrupts & warmup */
+#define BENCH_RUNS 16
+
+#endif
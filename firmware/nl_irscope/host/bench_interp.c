@@ -0,0 +1,85 @@
+/*
+ * bench_interp.c - host check & benchmark of the bilinear upscale
+ * 10-19-26 E. Brombaugh
+ *
+ * Checks every output pixel of a random frame against a floating point
+ * bilinear reference to within a quarter of an element LSB, then reports
+ * the cost of a full 80x80 frame.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "interp.h"
+
+#define FRAMES 1000
+
+/*
+ * reference value at output x, y in INTERP_FRAC units
+ */
+double ref_pixel(int16_t *src, int x, int y)
+{
+	double sx = (x+0.5)/INTERP_SCALE-0.5, sy = (y+0.5)/INTERP_SCALE-0.5;
+	double fx, fy, a, b;
+	int kx, ky;
+	
+	sx = sx < 0 ? 0 : sx > INTERP_SRC-1 ? INTERP_SRC-1 : sx;
+	sy = sy < 0 ? 0 : sy > INTERP_SRC-1 ? INTERP_SRC-1 : sy;
+	kx = sx < INTERP_SRC-1 ? (int)sx : INTERP_SRC-2;
+	ky = sy < INTERP_SRC-1 ? (int)sy : INTERP_SRC-2;
+	fx = sx-kx;
+	fy = sy-ky;
+	a = src[ky*8+kx]*(1-fx) + src[ky*8+kx+1]*fx;
+	b = src[(ky+1)*8+kx]*(1-fx) + src[(ky+1)*8+kx+1]*fx;
+	return (a*(1-fy) + b*fy) * (1<<INTERP_FRAC);
+}
+
+int main(void)
+{
+	int16_t src[64], line[INTERP_DST];
+	INTERP_STATE is;
+	uint64_t t, best = ~0ULL;
+	double err, maxerr = 0;
+	int x, y, i, r;
+	
+	/* -10C to 90C in 0.25C units */
+	srand(1);
+	for(i=0;i<64;i++)
+		src[i] = (rand()%400)-40;
+	
+	interp_start(&is, src);
+	for(y=0;y<INTERP_DST;y++)
+	{
+		interp_row(&is, line);
+		for(x=0;x<INTERP_DST;x++)
+		{
+			err = ref_pixel(src, x, y) - line[x];
+			err = err < 0 ? -err : err;
+			maxerr = err > maxerr ? err : maxerr;
+		}
+	}
+	printf("interp: max error %.2f of 1/%d element LSB\n", maxerr, 1<<INTERP_FRAC);
+	if(maxerr > (1<<INTERP_FRAC)/4)
+	{
+		printf("interp: FAIL\n");
+		return 1;
+	}
+	
+	for(r=0;r<BENCH_RUNS;r++)
+	{
+		t = bench_clocks();
+		for(i=0;i<FRAMES;i++)
+		{
+			interp_start(&is, src);
+			for(y=0;y<INTERP_DST;y++)
+				interp_row(&is, line);
+		}
+		t = bench_clocks() - t;
+		best = t < best ? t : best;
+	}
+	printf("interp: %llu host %s per 80x80 frame\n",
+		(unsigned long long)(best/FRAMES), BENCH_UNIT);
+	
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * bench_stats.c - host check & benchmark of the fused frame statistics
+ * 10-19-26 E. Brombaugh
+ *
+ * Checks the fused pass, gathered a row at a time as the firmware does,
+ * against separate passes for each statistic, then reports the cost per
+ * frame of both.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "stats.h"
+
+#define FRAMES 100000
+
+/*
+ * one walk over the frame for each statistic
+ */
+void stats_separate(FSTATS *s, int16_t *ir)
+{
+	uint8_t i;
+
+	s->min = 0x7fff;
+	for(i=0;i<64;i++)
+		if(ir[i] < s->min)
+		{
+			s->min = ir[i];
+			s->argmin = i;
+		}
+
+	s->max = -0x8000;
+	for(i=0;i<64;i++)
+		if(ir[i] > s->max)
+		{
+			s->max = ir[i];
+			s->argmax = i;
+		}
+
+	s->sum = 0;
+	for(i=0;i<64;i++)
+		s->sum += ir[i];
+	s->mean = s->sum >> 6;
+}
+
+/*
+ * fused pass a row at a time
+ */
+void stats_rows(FSTATS *s, int16_t *ir)
+{
+	uint8_t row;
+
+	stats_start(s);
+	for(row=0;row<8;row++)
+		stats_elems(s, ir, row*8, 8);
+	stats_done(s);
+}
+
+/*
+ * best per-frame cost of one way of gathering over a set of frames
+ */
+uint64_t bench(void (*fn)(FSTATS *, int16_t *), int16_t (*src)[64], int n)
+{
+	FSTATS s;
+	uint64_t t, best = ~0ULL;
+	volatile int32_t sink;
+	int i, r;
+
+	for(r=0;r<BENCH_RUNS;r++)
+	{
+		t = bench_clocks();
+		for(i=0;i<FRAMES;i++)
+		{
+			fn(&s, src[i % n]);
+			sink = s.sum + s.argmax;
+		}
+		t = bench_clocks() - t;
+		best = t < best ? t : best;
+	}
+	(void)sink;
+
+	return best/FRAMES;
+}
+
+int main(void)
+{
+	int16_t src[16][64];
+	FSTATS a, b;
+	uint64_t fused, separate;
+	int i, f, ok = 1;
+
+	/* -10C to 90C in 0.25C units, with repeats to exercise the positions */
+	srand(1);
+	for(f=0;f<16;f++)
+		for(i=0;i<64;i++)
+			src[f][i] = (rand()%400)-40;
+	src[1][5] = src[1][40] = -100;
+	src[1][9] = src[1][60] = 500;
+
+	for(f=0;f<16;f++)
+	{
+		stats_rows(&a, src[f]);
+		stats_separate(&b, src[f]);
+		ok &= (a.min == b.min) && (a.argmin == b.argmin);
+		ok &= (a.max == b.max) && (a.argmax == b.argmax);
+		ok &= (a.sum == b.sum) && (a.mean == b.mean);
+	}
+	if(!ok)
+	{
+		printf("stats: FAIL\n");
+		return 1;
+	}
+
+	fused = bench(stats_rows, src, 16);
+	separate = bench(stats_separate, src, 16);
+	printf("stats: %llu host %s per frame fused, %llu separate\n",
+		(unsigned long long)fused, BENCH_UNIT, (unsigned long long)separate);
+
+	return 0;
+}
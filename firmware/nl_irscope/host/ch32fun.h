@@ -0,0 +1,173 @@
+/*
+ * ch32fun.h - host stand-in for the ch32fun register definitions
+ * 10-19-26 E. Brombaugh
+ *
+ * Just enough of the CH32V003 for the firmware headers to build with the
+ * host compiler. Peripherals are plain structs in host memory and IRQ
+ * handlers are plain functions for a test to call. I2C1 goes through
+ * host_i2c(), which a test that uses it provides, so it can model the
+ * controller between register accesses.
+ */
+
+#ifndef __ch32fun__
+#define __ch32fun__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FUNCONF_SYSTEM_CORE_CLOCK 48000000
+
+/* handlers are called directly */
+#define interrupt unused
+
+#define __IO volatile
+
+typedef struct
+{
+	__IO uint32_t CFGLR, CFGHR, INDR, OUTDR, BSHR, BCR, LCKR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CTLR, CFGR0, INTR, APB2PRSTR, APB1PRSTR, AHBPCENR,
+		APB2PCENR, APB1PCENR, BDCTLR, RSTSCKR;
+} RCC_TypeDef;
+
+typedef struct
+{
+	__IO uint16_t CTLR1;
+	uint16_t RESERVED0;
+	__IO uint16_t CTLR2;
+	uint16_t RESERVED1;
+	__IO uint16_t OADDR1;
+	uint16_t RESERVED2;
+	__IO uint16_t OADDR2;
+	uint16_t RESERVED3;
+	__IO uint16_t DATAR;
+	uint16_t RESERVED4;
+	__IO uint16_t STAR1;
+	uint16_t RESERVED5;
+	__IO uint16_t STAR2;
+	uint16_t RESERVED6;
+	__IO uint16_t CKCFGR;
+	uint16_t RESERVED7;
+} I2C_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CTLR, SR, CNT, RESERVED0, CMP, RESERVED1;
+} SysTick_Type;
+
+typedef struct
+{
+	__IO uint32_t CFGR, CNTR, PADDR, MADDR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t INTFR, INTFCR;
+} DMA_TypeDef;
+
+GPIO_TypeDef host_gpioa, host_gpioc, host_gpiod;
+RCC_TypeDef host_rcc;
+SysTick_Type host_systick;
+DMA_TypeDef host_dma1;
+DMA_Channel_TypeDef host_dma1_ch7;
+
+I2C_TypeDef *host_i2c(void);
+
+#define GPIOA (&host_gpioa)
+#define GPIOC (&host_gpioc)
+#define GPIOD (&host_gpiod)
+#define RCC (&host_rcc)
+#define SysTick (&host_systick)
+#define DMA1 (&host_dma1)
+#define DMA1_Channel7 (&host_dma1_ch7)
+#define I2C1 (host_i2c())
+
+enum IRQn
+{
+	SysTicK_IRQn = 12,
+	DMA1_Channel7_IRQn = 28,
+	I2C1_EV_IRQn = 30,
+	I2C1_ER_IRQn = 31,
+};
+
+static inline void NVIC_EnableIRQ(int irq) {}
+static inline void NVIC_DisableIRQ(int irq) {}
+#define __disable_irq() do {} while(0)
+#define __enable_irq() do {} while(0)
+#define __WFI() do {} while(0)
+
+/* time only passes when something waits */
+static inline void Delay_Us(uint32_t us)
+{
+	SysTick->CNT += us*(FUNCONF_SYSTEM_CORE_CLOCK/1000000);
+}
+
+static inline void Delay_Ms(uint32_t ms)
+{
+	Delay_Us(ms*1000);
+}
+
+#define RCC_AHBPeriph_DMA1 0x0001
+#define RCC_APB2Periph_AFIO 0x0001
+#define RCC_APB2Periph_GPIOA 0x0004
+#define RCC_APB2Periph_GPIOC 0x0010
+#define RCC_APB2Periph_GPIOD 0x0020
+#define RCC_APB1Periph_I2C1 0x00200000
+
+#define GPIO_Speed_10MHz 0x1
+#define GPIO_CNF_IN_FLOATING 0x4
+#define GPIO_CNF_IN_PUPD 0x8
+#define GPIO_CNF_OUT_PP 0x0
+#define GPIO_CNF_OUT_OD 0x4
+#define GPIO_CNF_OUT_PP_AF 0x8
+#define GPIO_CNF_OUT_OD_AF 0xC
+
+#define I2C_CTLR1_PE 0x0001
+#define I2C_CTLR1_START 0x0100
+#define I2C_CTLR1_STOP 0x0200
+#define I2C_CTLR1_ACK 0x0400
+#define I2C_CTLR1_POS 0x0800
+#define I2C_CTLR1_SWRST 0x8000
+#define CTLR1_ACK_Set 0x0400
+#define CTLR1_ACK_Reset 0xFBFF
+
+#define I2C_CTLR2_FREQ 0x003F
+#define I2C_CTLR2_ITERREN 0x0100
+#define I2C_CTLR2_ITEVTEN 0x0200
+#define I2C_CTLR2_ITBUFEN 0x0400
+#define I2C_CTLR2_DMAEN 0x0800
+#define I2C_CTLR2_LAST 0x1000
+
+#define I2C_STAR1_SB 0x0001
+#define I2C_STAR1_ADDR 0x0002
+#define I2C_STAR1_BTF 0x0004
+#define I2C_STAR1_RXNE 0x0040
+#define I2C_STAR1_TXE 0x0080
+#define I2C_STAR1_BERR 0x0100
+#define I2C_STAR1_ARLO 0x0200
+#define I2C_STAR1_AF 0x0400
+#define I2C_STAR1_OVR 0x0800
+
+#define I2C_STAR2_MSL 0x0001
+#define I2C_STAR2_BUSY 0x0002
+
+#define I2C_CKCFGR_CCR 0x0FFF
+#define I2C_CKCFGR_DUTY 0x4000
+#define I2C_CKCFGR_FS 0x8000
+
+#define DMA_CFGR1_EN 0x0001
+#define DMA_CFGR1_TCIE 0x0002
+#define DMA_CFGR1_TEIE 0x0008
+#define DMA_CFGR1_DIR 0x0010
+#define DMA_CFGR1_MINC 0x0080
+
+#define DMA_GIF7 0x01000000
+#define DMA_TCIF7 0x02000000
+#define DMA_TEIF7 0x08000000
+#define DMA_CGIF7 0x01000000
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * test.h - minimal checks for the host tests
+ * 10-19-26 E. Brombaugh
+ */
+
+#ifndef __test__
+#define __test__
+
+int test_checks, test_fails;
+
+/* count a check, report it if it fails */
+#define CHECK(c) do { \
+	test_checks++; \
+	if(!(c)) \
+	{ \
+		test_fails++; \
+		printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #c); \
+	} \
+} while(0)
+
+/*
+ * summary & exit status
+ */
+int test_done(const char *name)
+{
+	printf("%s: %d checks, %d failed\n", name, test_checks, test_fails);
+	return test_fails ? 1 : 0;
+}
+
+#endif
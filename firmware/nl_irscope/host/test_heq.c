@@ -0,0 +1,211 @@
+/*
+ * test_heq.c - host test of the histogram equalized color map
+ * 10-19-26 E. Brombaugh
+ *
+ * Synthetic frames in raw sensor units (0.25C): a low-contrast scene that a
+ * linear map would squash into a few colors, a gradient with every level
+ * used once, a flat frame and one with outliers past the top bin. Then the
+ * frames of SCENE, in the CSV that irstream.py replay --csv prints, must come
+ * out with more contrast than the auto ranged linear map gives them.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "heq.h"
+#include "agc.h"
+
+#define FRAC 4		// fraction bits of the upscaled values
+#define SCENE "heq_scene.csv"
+
+/*
+ * min of a frame, as the stats would give it
+ */
+int16_t frame_min(int16_t *ir)
+{
+	int16_t min = ir[0];
+	int i;
+
+	for(i=1;i<64;i++)
+		min = ir[i] < min ? ir[i] : min;
+	return min;
+}
+
+/*
+ * scale must never step down across the whole input range
+ */
+void check_monotonic(int16_t lo, int16_t hi)
+{
+	int16_t v;
+	uint8_t s, last = 0;
+	int ok = 1;
+
+	for(v=lo;v<=hi;v++)
+	{
+		s = heq_scale(v, FRAC);
+		ok &= s >= last;
+		last = s;
+	}
+	CHECK(ok);
+}
+
+/*
+ * next frame of a replay --csv file in raw units - returns FALSE at the end,
+ * skipping # comments
+ */
+int scene_frame(FILE *f, int16_t *ir)
+{
+	char line[1024], *p;
+	double t;
+	int i;
+
+	do
+		if(!fgets(line, sizeof(line), f))
+			return 0;
+	while(line[0] == '#');
+
+	/* sequence & thermistor come before the elements */
+	p = strchr(line, ',');
+	p = p ? strchr(p+1, ',') : NULL;
+	for(i=0;p && (i<64);i++)
+	{
+		t = strtod(p+1, &p) * 4;
+		ir[i] = t < 0 ? t - 0.5 : t + 0.5;
+		p = strchr(p, ',');
+	}
+	return i == 64;
+}
+
+/*
+ * spread of a mapped frame - the range of the scale used by the elements
+ * below the frame mean and by those at or above it
+ */
+void spread(uint8_t *s, int16_t *ir, int *cool, int *warm)
+{
+	int i, mean = 0, lo[2] = {255, 255}, hi[2] = {0, 0}, k;
+
+	for(i=0;i<64;i++)
+		mean += ir[i];
+	mean /= 64;
+
+	for(i=0;i<64;i++)
+	{
+		k = ir[i] >= mean;
+		lo[k] = s[i] < lo[k] ? s[i] : lo[k];
+		hi[k] = s[i] > hi[k] ? s[i] : hi[k];
+	}
+	*cool = hi[0] - lo[0];
+	*warm = hi[1] - lo[1];
+}
+
+/*
+ * equalized & linear maps of each frame of the scene file
+ */
+void check_scene(void)
+{
+	FILE *f = fopen(SCENE, "r");
+	int16_t ir[64], base, min, max;
+	uint16_t gain;
+	uint8_t lin[64], eq[64];
+	int i, v, cool_lin, cool_eq, warm_lin, warm_eq, frames = 0;
+
+	CHECK(f != NULL);
+	if(!f)
+		return;
+
+	while(scene_frame(f, ir))
+	{
+		/* linear map as auto ranging sets it on a first frame */
+		min = max = ir[0];
+		for(i=1;i<64;i++)
+		{
+			min = ir[i] < min ? ir[i] : min;
+			max = ir[i] > max ? ir[i] : max;
+		}
+		agc_init();
+		agc_frame_done(min, max);
+		agc_get_map(&base, &gain, 0);
+
+		heq_build(ir, min);
+		for(i=0;i<64;i++)
+		{
+			v = ((ir[i] - base) * gain) >> 8;
+			lin[i] = v < 0 ? 0 : v > 255 ? 255 : v;
+			eq[i] = heq_scale(ir[i]<<FRAC, FRAC);
+		}
+
+		/* wall gets far more of the scale, both more than the gap */
+		spread(lin, ir, &cool_lin, &warm_lin);
+		spread(eq, ir, &cool_eq, &warm_eq);
+		CHECK(cool_eq > 2*cool_lin);
+		CHECK(cool_eq + warm_eq > cool_lin + warm_lin);
+		frames++;
+	}
+	fclose(f);
+	CHECK(frames > 0);
+}
+
+int main(void)
+{
+	int16_t ir[64];
+	int i, used;
+
+	/* 25C to 26.25C scene, 5 levels each on 12 or 13 elements */
+	for(i=0;i<64;i++)
+		ir[i] = 100 + (i*5)/64;
+	heq_build(ir, frame_min(ir));
+	CHECK(heq_base == 100);
+	for(i=0;i<4;i++)
+		CHECK(heq_lut[i+1] > heq_lut[i] + 40);
+	CHECK(heq_lut[0] < 30);
+	CHECK(heq_lut[4] > 225);
+	check_monotonic(90<<FRAC, 110<<FRAC);
+
+	/* levels in between are blended */
+	CHECK(heq_scale((101<<FRAC) + (1<<(FRAC-1)), FRAC) ==
+		(heq_lut[1] + heq_lut[2])/2);
+
+	/* every level once - rank i is (2i+1)/128 of full scale */
+	for(i=0;i<64;i++)
+		ir[i] = 40 + 63 - i;
+	heq_build(ir, frame_min(ir));
+	used = 0;
+	for(i=0;i<64;i++)
+		used += heq_lut[i] == (((2*i+1)*255) >> 7);
+	CHECK(used == 64);
+	CHECK(heq_scale(0, FRAC) == heq_lut[0]);
+	CHECK(heq_scale(200<<FRAC, FRAC) == heq_lut[63]);
+	check_monotonic(0, 200<<FRAC);
+
+	/* flat frame sits mid scale */
+	for(i=0;i<64;i++)
+		ir[i] = 88;
+	heq_build(ir, frame_min(ir));
+	CHECK(heq_lut[0] == 127);
+	CHECK(heq_scale(88<<FRAC, FRAC) == 127);
+
+	/* hot outliers land in the top bin without disturbing the rest */
+	for(i=0;i<64;i++)
+		ir[i] = i < 60 ? 80 + (i & 3) : 400 + i;
+	heq_build(ir, frame_min(ir));
+	CHECK(heq_lut[HEQ_BINS-1] == (((2*60+4)*255) >> 7));
+	CHECK(heq_lut[HEQ_BINS-1] > 245);
+	CHECK(heq_lut[3] < heq_lut[HEQ_BINS-1]);
+	for(i=0;i<4;i++)
+		CHECK(heq_lut[i] == (((2*15*i+15)*255) >> 7));
+	check_monotonic(0, 500<<FRAC);
+
+	/* negative temperatures work the same */
+	for(i=0;i<64;i++)
+		ir[i] = -40 + (i & 7);
+	heq_build(ir, frame_min(ir));
+	CHECK(heq_base == -40);
+	CHECK(heq_lut[0] < heq_lut[7]);
+	check_monotonic(-50<<FRAC, -30<<FRAC);
+
+	check_scene();
+
+	return test_done("heq");
+}
@@ -0,0 +1,120 @@
+/*
+ * test_history.c - host test of the frame history ring
+ * 10-19-26 E. Brombaugh
+ *
+ * Frames go in and every frame still held must come back out exactly:
+ * random walks that stay within a nibble, steps that escape to full values,
+ * negative readings and a ring too small for more than a couple of frames.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "history.h"
+
+#define FRAMES 600
+
+/* SRAM stand-in with the linker symbols placed inside it */
+uint8_t sram[1536] __attribute__((aligned(4)));
+__asm__(".globl _ebss\n.set _ebss, sram+101\n"
+	".globl _eusrstack\n.set _eusrstack, sram+1536");
+
+uint8_t mem[10000] __attribute__((aligned(4)));
+int16_t frames[FRAMES][64];
+
+/*
+ * deterministic noise
+ */
+uint32_t rnd_state = 1;
+uint32_t rnd(void)
+{
+	rnd_state = rnd_state*1103515245 + 12345;
+	return rnd_state >> 16;
+}
+
+/*
+ * frame n from frame n-1 - mostly small steps, with big ones 1 in big
+ */
+void make_frame(int n, int big)
+{
+	int i;
+
+	for(i=0;i<64;i++)
+	{
+		if(!n)
+			frames[n][i] = 100 + (rnd() & 31);
+		else if(big && !(rnd() % big))
+			frames[n][i] = (int16_t)(rnd() & 0xfff) - 0x400;
+		else
+			frames[n][i] = frames[n-1][i] + (int)(rnd() % 15) - 7;
+	}
+}
+
+/*
+ * add n frames, checking every one still held after each add - returns the
+ * most frames held at once
+ */
+int run(int n, int big)
+{
+	int16_t f[64];
+	int i, k, ok = 1, most = 0;
+
+	for(i=0;i<n;i++)
+	{
+		make_frame(i, big);
+		hist_add(frames[i]);
+		most = hist_frames > most ? hist_frames : most;
+		ok &= (hist_frames >= 1) && (hist_frames <= i+1);
+		for(k=0;ok && (k<hist_frames);k++)
+		{
+			hist_frame(k, f);
+			ok &= !memcmp(f, frames[i+1-hist_frames+k], sizeof(f));
+		}
+		ok &= hist_used <= hist_size;
+	}
+	CHECK(ok);
+
+	return most;
+}
+
+int main(void)
+{
+	int most;
+
+	/* what's left between .bss & the stack, from 4-byte aligned */
+	hist_init();
+	CHECK((uint8_t *)hist_base == &sram[104]);
+	CHECK(hist_size == 1536 - HIST_STACK - 104 - 2*64*sizeof(int16_t));
+
+	/* too small for the frames & a worst case record */
+	hist_setup(mem, 2*64*sizeof(int16_t) + HIST_REC_MAX - 1);
+	CHECK(hist_size == 0);
+	hist_add(frames[0]);
+	CHECK(hist_frames == 0);
+
+	/* the guaranteed minimum keeps a few frames, even all escaped */
+	hist_setup(mem, HIST_MIN);
+	CHECK(hist_size >= HIST_REC_MAX);
+	most = run(100, 1);
+	CHECK(most == 2);
+	hist_setup(mem, HIST_MIN);
+	most = run(100, 0);
+	CHECK(most >= 5);
+
+	/* noise with the odd big step, wrapping the ring many times */
+	hist_setup(mem, 1000);
+	most = run(FRAMES, 20);
+	CHECK(most > 10);
+
+	/* still scene fills the frame count before the ring */
+	hist_setup(mem, sizeof(mem));
+	memset(frames, 0, sizeof(frames));
+	hist_add(frames[0]);
+	for(most=1;most<300;most++)
+		hist_add(frames[0]);
+	CHECK(hist_frames == 255);
+	CHECK(hist_used == 254*33);
+
+	return test_done("history");
+}
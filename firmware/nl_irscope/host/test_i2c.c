@@ -0,0 +1,578 @@
+/*
+ * test_i2c.c - host test of the I2C1 transaction engine
+ * 10-19-26 E. Brombaugh
+ *
+ * The I2C1 registers are backed by a model of the controller in master
+ * mode talking to one register-file slave. The model does what the
+ * hardware would do on its own - START, address & data bytes, STOP, DMA -
+ * each time the driver touches a register, and the test loop raises the
+ * event, error & DMA IRQs whenever their flags & enables are set. Every
+ * bus condition goes in a log so whole transactions can be compared:
+ *   S / Sr / P    start, repeated start, stop
+ *   xx+ / xx-     byte & whether the receiver ACKed it
+ */
+
+#include "ch32fun.h"
+#include <stdarg.h>
+#include "test.h"
+#include "i2c.h"
+
+#define SLAVE 0x69				// the AMG8833's address
+
+enum model_phases
+{
+	M_IDLE,
+	M_ADDR,			// SB set, waiting for the address byte
+	M_TXADDR,		// write address ACKed, ADDR set
+	M_TX,
+	M_RXADDR,		// read address ACKed, ADDR set
+	M_RX,
+	M_ERR,			// NACKed, waiting for STOP
+	M_HUNG,			// slave holds SCL low
+};
+
+#define EMPTY 0xffff			// DATAR with nothing written
+
+I2C_TypeDef i2c_regs;
+uint8_t m_phase, m_owned, m_first, m_nacked;
+uint8_t *dma_buf;				// memory MADDR stands for
+
+/* slave behaviour */
+uint8_t slave_regs[256], slave_ptr;
+uint8_t slave_nack_addr, slave_hang, dma_fail;
+
+char bus_log[1024];
+int callbacks;
+
+/*
+ * add to the bus log
+ */
+void bus(const char *fmt, ...)
+{
+	va_list ap;
+	size_t n = strlen(bus_log);
+
+	va_start(ap, fmt);
+	vsnprintf(bus_log + n, sizeof(bus_log) - n, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * slave byte for the master to read
+ */
+uint8_t slave_read(void)
+{
+	return slave_regs[slave_ptr++];
+}
+
+/*
+ * things the controller does on its own - runs on every register access
+ */
+void model_step(void)
+{
+	uint16_t d;
+
+	/* a stuck slave stops everything */
+	if(m_phase == M_HUNG)
+		return;
+
+	/* start or repeated start */
+	if((i2c_regs.CTLR1 & I2C_CTLR1_START) && ((m_phase == M_IDLE) ||
+		((m_phase == M_TX) && (i2c_regs.STAR1 & I2C_STAR1_BTF))))
+	{
+		i2c_regs.CTLR1 &= ~I2C_CTLR1_START;
+		i2c_regs.STAR1 &= ~(I2C_STAR1_BTF | I2C_STAR1_TXE);
+		if(slave_hang)
+		{
+			m_phase = M_HUNG;
+			return;
+		}
+		i2c_regs.STAR1 |= I2C_STAR1_SB;
+		i2c_regs.STAR2 |= I2C_STAR2_BUSY | I2C_STAR2_MSL;
+		bus(m_owned ? "Sr " : "S ");
+		m_owned = 1;
+		m_phase = M_ADDR;
+	}
+
+	/* address byte */
+	d = i2c_regs.DATAR;
+	if((m_phase == M_ADDR) && (d != EMPTY))
+	{
+		i2c_regs.DATAR = EMPTY;
+		i2c_regs.STAR1 &= ~I2C_STAR1_SB;
+		if(((d>>1) != SLAVE) || slave_nack_addr)
+		{
+			bus("%02x- ", d);
+			i2c_regs.STAR1 |= I2C_STAR1_AF;
+			m_phase = M_ERR;
+		}
+		else
+		{
+			bus("%02x+ ", d);
+			i2c_regs.STAR1 |= I2C_STAR1_ADDR;
+			m_phase = d & 1 ? M_RXADDR : M_TXADDR;
+			m_first = 1;
+			m_nacked = 0;
+		}
+	}
+
+	/* register pointer, then data */
+	d = i2c_regs.DATAR;
+	if(((m_phase == M_TXADDR) || (m_phase == M_TX)) && (d != EMPTY))
+	{
+		i2c_regs.DATAR = EMPTY;
+		if(m_first)
+			slave_ptr = d;
+		else
+			slave_regs[slave_ptr++] = d;
+		m_first = 0;
+		bus("%02x+ ", d);
+		i2c_regs.STAR1 = (i2c_regs.STAR1 & ~I2C_STAR1_BTF) | I2C_STAR1_TXE;
+	}
+
+	/* DMA takes the whole read, NACKing the last byte when LAST is set */
+	if((m_phase == M_RX) && !m_nacked && (i2c_regs.CTLR2 & I2C_CTLR2_DMAEN) &&
+		(DMA1_Channel7->CFGR & DMA_CFGR1_EN))
+	{
+		CHECK((uint32_t)(uintptr_t)dma_buf == DMA1_Channel7->MADDR);
+		if(dma_fail)
+			DMA1->INTFR |= DMA_TEIF7 | DMA_GIF7;
+		else
+		{
+			while(DMA1_Channel7->CNTR)
+			{
+				d = slave_read();
+				*dma_buf++ = d;
+				DMA1_Channel7->CNTR--;
+				m_nacked = !DMA1_Channel7->CNTR &&
+					(i2c_regs.CTLR2 & I2C_CTLR2_LAST);
+				bus("%02x%c ", d, m_nacked ? '-' : '+');
+			}
+			DMA1->INTFR |= DMA_TCIF7 | DMA_GIF7;
+		}
+		m_nacked = 1;
+	}
+
+	/* byte at a time, ACKed per the ACK bit */
+	if((m_phase == M_RX) && !m_nacked && !(i2c_regs.CTLR2 & I2C_CTLR2_DMAEN) &&
+		!(i2c_regs.STAR1 & I2C_STAR1_RXNE))
+	{
+		d = slave_read();
+		i2c_regs.DATAR = d;
+		m_nacked = !(i2c_regs.CTLR1 & I2C_CTLR1_ACK);
+		bus("%02x%c ", d, m_nacked ? '-' : '+');
+		i2c_regs.STAR1 |= I2C_STAR1_RXNE;
+	}
+
+	/* stop once any read has ended & the address phase is over */
+	if((i2c_regs.CTLR1 & I2C_CTLR1_STOP) && (m_phase != M_TXADDR) &&
+		(m_phase != M_RXADDR) && ((m_phase != M_RX) || m_nacked))
+	{
+		i2c_regs.CTLR1 &= ~(I2C_CTLR1_STOP | I2C_CTLR1_START);
+		i2c_regs.STAR1 &= ~(I2C_STAR1_SB | I2C_STAR1_BTF | I2C_STAR1_TXE);
+		i2c_regs.STAR2 &= ~(I2C_STAR2_BUSY | I2C_STAR2_MSL);
+		if(m_owned)
+			bus("P ");
+		m_owned = 0;
+		m_phase = M_IDLE;
+	}
+}
+
+/*
+ * register access hook - each one takes a microsecond
+ */
+I2C_TypeDef *host_i2c(void)
+{
+	SysTick->CNT += FUNCONF_SYSTEM_CORE_CLOCK/1000000;
+	model_step();
+	return &i2c_regs;
+}
+
+/*
+ * true when the event IRQ would fire
+ */
+uint8_t ev_pending(void)
+{
+	uint16_t s = i2c_regs.STAR1, c = i2c_regs.CTLR2;
+
+	if(!(c & I2C_CTLR2_ITEVTEN))
+		return 0;
+	if(s & (I2C_STAR1_SB | I2C_STAR1_ADDR | I2C_STAR1_BTF))
+		return 1;
+	return (c & I2C_CTLR2_ITBUFEN) && (s & (I2C_STAR1_TXE | I2C_STAR1_RXNE));
+}
+
+/*
+ * true when the error IRQ would fire
+ */
+uint8_t er_pending(void)
+{
+	return (i2c_regs.CTLR2 & I2C_CTLR2_ITERREN) &&
+		(i2c_regs.STAR1 & I2C_STAR1_ERRORS);
+}
+
+/*
+ * true when the DMA IRQ would fire
+ */
+uint8_t dma_pending(void)
+{
+	uint32_t f = DMA1->INTFR, c = DMA1_Channel7->CFGR;
+
+	return (c & DMA_CFGR1_EN) && (((f & DMA_TCIF7) && (c & DMA_CFGR1_TCIE)) ||
+		((f & DMA_TEIF7) && (c & DMA_CFGR1_TEIE)));
+}
+
+/*
+ * raise IRQs until the bus settles
+ */
+void run(void)
+{
+	uint16_t star1;
+	int n;
+
+	for(n=0;n<1000;n++)
+	{
+		model_step();
+		star1 = i2c_regs.STAR1;
+		if(er_pending())
+		{
+			/* error flags are write 0 to clear */
+			I2C1_ER_IRQHandler();
+			i2c_regs.STAR1 &= star1 | ~I2C_STAR1_ERRORS;
+		}
+		else if(ev_pending())
+		{
+			/* STAR1 then STAR2 clears ADDR, reading DATAR clears RXNE */
+			I2C1_EV_IRQHandler();
+			i2c_regs.STAR1 &= ~(star1 & (I2C_STAR1_ADDR | I2C_STAR1_RXNE));
+			if((star1 & I2C_STAR1_ADDR) && (m_phase == M_TXADDR))
+			{
+				m_phase = M_TX;
+				model_step();
+			}
+			else if((star1 & I2C_STAR1_ADDR) && (m_phase == M_RXADDR))
+				m_phase = M_RX;
+		}
+		else if(dma_pending())
+		{
+			DMA1_Channel7_IRQHandler();
+			DMA1->INTFR &= ~(DMA1->INTFCR & DMA_CGIF7 ? 0x0f000000 : 0);
+			DMA1->INTFCR = 0;
+		}
+		else if((m_phase == M_TX) && (i2c_regs.STAR1 & I2C_STAR1_TXE) &&
+			!(i2c_regs.STAR1 & I2C_STAR1_BTF))
+		{
+			/* nothing more was written - the last byte finishes */
+			i2c_regs.STAR1 |= I2C_STAR1_BTF;
+		}
+		else
+			return;
+	}
+	CHECK(!"bus never settled");
+}
+
+/*
+ * fresh bus, slave & driver
+ */
+void reset(void)
+{
+	memset(&i2c_regs, 0, sizeof(i2c_regs));
+	i2c_regs.DATAR = EMPTY;
+	memset(&host_dma1, 0, sizeof(host_dma1));
+	memset(&host_dma1_ch7, 0, sizeof(host_dma1_ch7));
+	m_phase = M_IDLE;
+	m_owned = m_nacked = 0;
+	slave_nack_addr = slave_hang = dma_fail = 0;
+	for(int i=0;i<256;i++)
+		slave_regs[i] = i ^ 0x5a;
+	bus_log[0] = 0;
+	callbacks = 0;
+
+	/* SDA idles high */
+	GPIOC->INDR = 1<<1;
+	i2c_rate = I2C_CLKRATE;
+	i2c_errors = i2c_retries = i2c_recoveries = 0;
+	i2c_init();
+}
+
+/*
+ * completion callback
+ */
+void done(I2C_XFER *x)
+{
+	callbacks++;
+}
+
+/*
+ * fill in a transaction
+ */
+void xfer(I2C_XFER *x, uint8_t reg, uint8_t dir, uint8_t *buf, uint16_t len)
+{
+	x->addr = SLAVE;
+	x->reg = reg;
+	x->dir = dir;
+	x->buf = buf;
+	x->len = len;
+	x->callback = done;
+	if(dir == I2C_READ)
+		dma_buf = buf;
+}
+
+/*
+ * register write - address & pointer, data, stop
+ */
+void test_write(void)
+{
+	uint8_t data[2] = {0xa5, 0x3c};
+	I2C_XFER x;
+
+	reset();
+	xfer(&x, 0x10, I2C_WRITE, data, 2);
+	CHECK(!i2c_submit(&x));
+	run();
+	CHECK(!strcmp(bus_log, "S d2+ 10+ a5+ 3c+ P "));
+	CHECK(x.status == I2C_DONE);
+	CHECK(callbacks == 1);
+	CHECK((slave_regs[0x10] == 0xa5) && (slave_regs[0x11] == 0x3c));
+	CHECK(!i2c_busy());
+}
+
+/*
+ * array read by DMA - repeated start, the last byte NACKed by LAST
+ */
+void test_read_dma(void)
+{
+	uint8_t buf[8];
+	I2C_XFER x;
+	int ok = 1;
+
+	reset();
+	xfer(&x, 0x80, I2C_READ, buf, 8);
+	CHECK(!i2c_submit(&x));
+	run();
+	CHECK(!strcmp(bus_log, "S d2+ 80+ Sr d3+ da+ db+ d8+ d9+ de+ df+ dc+ dd- P "));
+	CHECK(x.status == I2C_DONE);
+	CHECK(callbacks == 1);
+	for(int i=0;i<8;i++)
+		ok &= buf[i] == ((0x80+i) ^ 0x5a);
+	CHECK(ok);
+	CHECK(!(i2c_regs.CTLR2 & (I2C_CTLR2_DMAEN | I2C_CTLR2_LAST | I2C_CTLR2_ITALL)));
+	CHECK(!(DMA1_Channel7->CFGR & DMA_CFGR1_EN));
+}
+
+/*
+ * single byte read - NACK & STOP set up before ADDR clears
+ */
+void test_read_one(void)
+{
+	uint8_t buf[1] = {0};
+	I2C_XFER x;
+
+	reset();
+	xfer(&x, 0x0e, I2C_READ, buf, 1);
+	CHECK(!i2c_submit(&x));
+	run();
+	CHECK(!strcmp(bus_log, "S d2+ 0e+ Sr d3+ 54- P "));
+	CHECK(x.status == I2C_DONE);
+	CHECK(buf[0] == (0x0e ^ 0x5a));
+}
+
+/*
+ * queued transactions run back to back in order
+ */
+void test_queue(void)
+{
+	uint8_t data[1] = {0x01}, buf[2];
+	I2C_XFER w, r;
+
+	reset();
+	xfer(&w, 0x02, I2C_WRITE, data, 1);
+	xfer(&r, 0x02, I2C_READ, buf, 2);
+	CHECK(!i2c_submit(&w));
+	CHECK(!i2c_submit(&r));
+	run();
+	CHECK(!strcmp(bus_log, "S d2+ 02+ 01+ P S d2+ 02+ Sr d3+ 01+ 59- P "));
+	CHECK((w.status == I2C_DONE) && (r.status == I2C_DONE));
+	CHECK(callbacks == 2);
+	CHECK(buf[0] == 0x01);
+}
+
+/*
+ * the queue holds I2C_QUEUE-1
+ */
+void test_queue_full(void)
+{
+	uint8_t data[1];
+	I2C_XFER x[I2C_QUEUE];
+	int i;
+
+	reset();
+	slave_hang = 1;
+	for(i=0;i<I2C_QUEUE-1;i++)
+	{
+		xfer(&x[i], i, I2C_WRITE, data, 1);
+		CHECK(!i2c_submit(&x[i]));
+	}
+	xfer(&x[i], i, I2C_WRITE, data, 1);
+	CHECK(i2c_submit(&x[i]));
+}
+
+/*
+ * slave doesn't answer its address - AF aborts with a STOP
+ */
+void test_nack(void)
+{
+	uint8_t buf[8];
+	I2C_XFER x;
+
+	reset();
+	slave_nack_addr = 1;
+	xfer(&x, 0x80, I2C_READ, buf, 8);
+	CHECK(!i2c_submit(&x));
+	run();
+	CHECK(!strcmp(bus_log, "S d2- P "));
+	CHECK(x.status == I2C_ERROR);
+	CHECK(x.err == I2C_STAR1_AF);
+	CHECK(callbacks == 1);
+	CHECK(!i2c_busy());
+	CHECK(!(i2c_regs.STAR1 & I2C_STAR1_ERRORS));
+}
+
+/*
+ * a fault holds the queue so nothing starts on a faulted port until reset
+ */
+void test_hold(void)
+{
+	uint8_t data[1] = {0x01}, buf[8];
+	I2C_XFER r, w;
+
+	reset();
+	slave_nack_addr = 1;
+	xfer(&r, 0x80, I2C_READ, buf, 8);
+	xfer(&w, 0x02, I2C_WRITE, data, 1);
+	CHECK(!i2c_submit(&r));
+	CHECK(!i2c_submit(&w));
+	run();
+	CHECK(!strcmp(bus_log, "S d2- P "));
+	CHECK(r.status == I2C_ERROR);
+	CHECK(w.status == I2C_PENDING);
+	CHECK(!i2c_busy());
+	CHECK(callbacks == 1);
+
+	/* more can be queued but still nothing starts */
+	CHECK(!i2c_submit(&r));
+	run();
+	CHECK(!strcmp(bus_log, "S d2- P "));
+	CHECK(r.status == I2C_PENDING);
+	CHECK(w.status == I2C_PENDING);
+	CHECK(callbacks == 1);
+
+	/* reset releases it */
+	slave_nack_addr = 0;
+	i2c_reset(0);
+	run();
+	CHECK(!strcmp(bus_log, "S d2- P S d2+ 02+ 01+ P S d2+ 80+ Sr d3+ "
+		"da+ db+ d8+ d9+ de+ df+ dc+ dd- P "));
+	CHECK(w.status == I2C_DONE);
+	CHECK(r.status == I2C_DONE);
+	CHECK(callbacks == 3);
+	CHECK(i2c_recoveries == 0);
+}
+
+/*
+ * DMA transfer error ends the read with the DMA error flag
+ */
+void test_dma_error(void)
+{
+	uint8_t buf[8];
+	I2C_XFER x;
+
+	reset();
+	dma_fail = 1;
+	xfer(&x, 0x80, I2C_READ, buf, 8);
+	CHECK(!i2c_submit(&x));
+	run();
+	CHECK(!strcmp(bus_log, "S d2+ 80+ Sr d3+ P "));
+	CHECK(x.status == I2C_ERROR);
+	CHECK(x.err == I2C_ERR_DMA);
+	CHECK(!i2c_busy());
+}
+
+/*
+ * a slave holding the clock is given up on after I2C_TIMEOUT
+ */
+void test_timeout(void)
+{
+	uint8_t buf[8];
+	I2C_XFER x;
+
+	reset();
+	slave_hang = 1;
+	xfer(&x, 0x80, I2C_READ, buf, 8);
+	CHECK(!i2c_submit(&x));
+	run();
+	CHECK(i2c_pending(&x));
+	SysTick->CNT += (I2C_TIMEOUT-100)*(FUNCONF_SYSTEM_CORE_CLOCK/1000000);
+	CHECK(i2c_pending(&x));
+	SysTick->CNT += 200*(FUNCONF_SYSTEM_CORE_CLOCK/1000000);
+	CHECK(!i2c_pending(&x));
+	CHECK(x.status == I2C_ERROR);
+	CHECK(!i2c_busy());
+}
+
+/*
+ * clock config for standard, fast & fast 36% duty at several core clocks
+ */
+void test_ckcfgr(void)
+{
+	CHECK(i2c_ckcfgr(48000000, 100000, 0) == 0x00f0);
+	CHECK(i2c_ckcfgr(48000000, 400000, 0) == 0x8028);
+	CHECK(i2c_ckcfgr(48000000, 400000, 1) == 0xc005);
+	CHECK(i2c_ckcfgr(24000000, 100000, 0) == 0x0078);
+	CHECK(i2c_ckcfgr(24000000, 400000, 0) == 0x8014);
+	CHECK(i2c_ckcfgr(24000000, 400000, 1) == 0xc003);
+	CHECK(i2c_ckcfgr(8000000, 100000, 0) == 0x0028);
+	CHECK(i2c_ckcfgr(8000000, 400000, 0) == 0x8007);
+	CHECK(i2c_ckcfgr(8000000, 400000, 1) == 0xc001);
+
+	/* dividers round up so SCL is never faster than asked */
+	CHECK(i2c_ckcfgr(48000000, 70000, 0) == 343);
+	CHECK(i2c_ckcfgr(48000000, 300000, 0) == 0x8036);
+
+	/* out of range dividers are clamped */
+	CHECK(i2c_ckcfgr(1000000, 400000, 1) == 0xc001);
+	CHECK(i2c_ckcfgr(48000000, 1000, 0) == I2C_CKCFGR_CCR);
+}
+
+/*
+ * runtime speed change & the fall back to standard mode on a fault
+ */
+void test_speed(void)
+{
+	reset();
+	CHECK(i2c_regs.CKCFGR == 0x00f0);
+	i2c_speed(I2C_FASTRATE);
+	CHECK(i2c_regs.CKCFGR == 0x8028);
+	CHECK(i2c_recoveries == 0);
+	i2c_fault();
+	CHECK(i2c_rate == I2C_CLKRATE);
+	CHECK(i2c_regs.CKCFGR == 0x00f0);
+	CHECK((i2c_errors == 1) && (i2c_recoveries == 1));
+}
+
+int main(void)
+{
+	test_ckcfgr();
+	test_speed();
+	test_write();
+	test_read_dma();
+	test_read_one();
+	test_queue();
+	test_queue_full();
+	test_nack();
+	test_hold();
+	test_dma_error();
+	test_timeout();
+
+	return test_done("i2c");
+}
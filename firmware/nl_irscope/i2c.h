@@ -0,0 +1,617 @@
+/*
+ * i2c.h - single-file header for interrupt-driven I2C1 bus on PC1/PC2
+ * 10-19-26 E. Brombaugh
+ *
+ * A transaction is a register address write followed by either more writes
+ * or a repeated start and reads. Device drivers queue descriptors and the
+ * event IRQ walks each through a small state machine while the error IRQ
+ * aborts it, so several devices share the bus without anyone blocking.
+ * Reads of I2C_DMA_MIN bytes or more go by DMA on channel 7 with the LAST
+ * bit NACKing the final byte, leaving only a completion IRQ to set STOP.
+ * A fault holds the queue until the port has been reset, falling back to
+ * standard mode and clocking any stuck slave off the bus.
+ */
+
+#ifndef __i2c__
+#define __i2c__
+
+#include "systick.h"
+
+// I2C Bus clock rates - must be lower the Logic clock rate
+#define I2C_CLKRATE 100000
+#define I2C_FASTRATE 400000
+
+// I2C Logic clock rate - must be higher than Bus clock rate
+#define I2C_PRERATE 2000000
+
+// uncomment this for high-speed 36% duty cycle, otherwise 33%
+//#define I2C_DUTY
+
+// timeout in us for a transaction once it has the bus
+#define I2C_TIMEOUT 25000
+
+// tries for each blocking access
+#define I2C_TRIES 3
+
+// bus recovery half clock period in us
+#define I2C_HALFBIT 5
+
+// transactions waiting for the bus, power of 2
+#define I2C_QUEUE 4
+
+#define I2C_DMA_MIN 2		// shortest read worth DMA, LAST needs 2 or more
+#define I2C_ERR_DMA 0x8000	// err flag for DMA transfer error, not SMBALERT
+
+enum i2c_dirs
+{
+	I2C_WRITE,
+	I2C_READ,
+};
+
+enum i2c_status
+{
+	I2C_DONE,
+	I2C_PENDING,
+	I2C_ERROR,
+};
+
+/*
+ * transaction descriptor - must stay put until no longer pending
+ */
+typedef struct i2c_xfer
+{
+	uint8_t addr;				// 7-bit device address
+	uint8_t reg;				// register address sent first
+	uint8_t dir;				// I2C_WRITE or I2C_READ for the data
+	uint8_t *buf;				// data
+	uint16_t len;				// bytes of data
+	volatile uint8_t status;	// I2C_DONE, I2C_PENDING or I2C_ERROR
+	uint16_t err;				// STAR1 error flags when status is I2C_ERROR
+	void (*callback)(struct i2c_xfer *xfer);	// called from IRQ when finished
+} I2C_XFER;
+
+enum i2c_states
+{
+	I2C_ST_IDLE,
+	I2C_ST_ADDR,		// start sent, then device address for write
+	I2C_ST_WRITE,		// register address & data going out
+	I2C_ST_RESTART,		// repeated start, then device address for read
+	I2C_ST_READ,		// data coming in
+};
+
+#define I2C_STAR1_ERRORS (I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR)
+#define I2C_CTLR2_ITALL (I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITBUFEN | I2C_CTLR2_ITERREN)
+
+I2C_XFER * volatile i2c_cur;
+volatile uint8_t i2c_state;
+uint16_t i2c_cnt;
+uint32_t i2c_begun;
+
+/* queue - head is running or next to run, tail is next free */
+I2C_XFER *i2c_queue[I2C_QUEUE];
+volatile uint8_t i2c_head, i2c_tail;
+volatile uint8_t i2c_hold;			// nothing starts until i2c_reset()
+
+/* current bus clock rate */
+uint32_t i2c_rate = I2C_CLKRATE;
+
+/* bus health - 16 bits to keep the SRAM budget */
+uint16_t i2c_errors;		// faults of any kind
+uint16_t i2c_retries;		// blocking accesses tried again
+uint16_t i2c_recoveries;	// bus recovery sequences run
+
+/*
+ * clock config register for a bus rate from a core clock - rounds the
+ * divider up so SCL never runs faster than asked
+ */
+uint16_t i2c_ckcfgr(uint32_t sysclk, uint32_t rate, uint8_t duty)
+{
+	uint32_t div, ccr;
+
+	if(rate <= 100000)
+	{
+		// standard mode good to 100kHz, 50% duty cycle
+		div = 2*rate;
+		ccr = (sysclk + div - 1)/div;
+		ccr = ccr < 4 ? 4 : ccr;
+	}
+	else
+	{
+		// fast mode over 100kHz, 33% or 36% duty cycle
+		div = duty ? 25*rate : 3*rate;
+		ccr = (sysclk + div - 1)/div;
+		ccr = ccr < 1 ? 1 : ccr;
+	}
+	ccr = ccr > I2C_CKCFGR_CCR ? I2C_CKCFGR_CCR : ccr;
+
+	if(rate > 100000)
+		ccr |= I2C_CKCFGR_FS | (duty ? I2C_CKCFGR_DUTY : 0);
+	return ccr;
+}
+
+/*
+ * reset and init the I2C port
+ */
+void i2c_setup(void)
+{
+	uint16_t tempreg;
+
+	// Reset I2C1 to init all regs
+	RCC->APB1PRSTR |= RCC_APB1Periph_I2C1;
+	RCC->APB1PRSTR &= ~RCC_APB1Periph_I2C1;
+
+	// set freq
+	tempreg = I2C1->CTLR2;
+	tempreg &= ~I2C_CTLR2_FREQ;
+	tempreg |= (FUNCONF_SYSTEM_CORE_CLOCK/I2C_PRERATE)&I2C_CTLR2_FREQ;
+	I2C1->CTLR2 = tempreg;
+
+	// Set clock config
+#ifndef I2C_DUTY
+	I2C1->CKCFGR = i2c_ckcfgr(FUNCONF_SYSTEM_CORE_CLOCK, i2c_rate, 0);
+#else
+	I2C1->CKCFGR = i2c_ckcfgr(FUNCONF_SYSTEM_CORE_CLOCK, i2c_rate, 1);
+#endif
+
+	// Enable I2C
+	I2C1->CTLR1 |= I2C_CTLR1_PE;
+
+	// set ACK mode
+	I2C1->CTLR1 |= I2C_CTLR1_ACK;
+}
+
+/*
+ * set the config of the SDA (PC1) & SCL (PC2) pins
+ */
+void i2c_pins(uint32_t cnf)
+{
+	GPIOC->CFGLR &= ~((0xf<<(4*1)) | (0xf<<(4*2)));
+	GPIOC->CFGLR |= ((GPIO_Speed_10MHz | cnf)<<(4*1)) |
+		((GPIO_Speed_10MHz | cnf)<<(4*2));
+}
+
+/*
+ * returns TRUE while a transaction has the bus
+ */
+uint8_t i2c_busy(void)
+{
+	return i2c_state != I2C_ST_IDLE;
+}
+
+/*
+ * give the bus to the transaction at the head of the queue
+ */
+void i2c_begin(void)
+{
+	I2C_XFER *x = i2c_queue[i2c_head];
+	uint32_t start = SysTick->CNT;
+
+	i2c_cur = x;
+	i2c_cnt = 0;
+	i2c_state = I2C_ST_ADDR;
+	i2c_begun = start;
+
+	/* let the last STOP finish - a START now would be lost */
+	while((I2C1->CTLR1 & I2C_CTLR1_STOP) && SysTick_us_check(start, 4*I2C_HALFBIT));
+
+	/* ack by default, events & errors drive the rest */
+	I2C1->CTLR1 |= I2C_CTLR1_ACK;
+	I2C1->CTLR2 |= I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN;
+	I2C1->CTLR1 |= I2C_CTLR1_START;
+}
+
+/*
+ * start the next waiting transaction if the bus is free
+ */
+void i2c_kick(void)
+{
+	if(!i2c_busy() && !i2c_hold && (i2c_head != i2c_tail))
+		i2c_begin();
+}
+
+/*
+ * finish current transaction & move on - IRQ context
+ */
+void i2c_finish(uint8_t status)
+{
+	I2C_XFER *x = i2c_cur;
+
+	/* quiet the peripheral until the next one */
+	I2C1->CTLR2 &= ~(I2C_CTLR2_ITALL | I2C_CTLR2_DMAEN | I2C_CTLR2_LAST);
+	DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+	i2c_state = I2C_ST_IDLE;
+	i2c_cur = NULL;
+	i2c_head = (i2c_head+1) & (I2C_QUEUE-1);
+
+	/* the rest wait for the port to be reset after a fault */
+	if(status == I2C_ERROR)
+		i2c_hold = 1;
+
+	x->status = status;
+	if(x->callback)
+		x->callback(x);
+
+	i2c_kick();
+}
+
+/*
+ * queue a transaction - returns 1 if the queue is full
+ */
+uint8_t i2c_submit(I2C_XFER *x)
+{
+	uint8_t next = (i2c_tail+1) & (I2C_QUEUE-1);
+
+	if(next == i2c_head)
+		return 1;
+
+	x->status = I2C_PENDING;
+	x->err = 0;
+	i2c_queue[i2c_tail] = x;
+
+	__disable_irq();
+	i2c_tail = next;
+	i2c_kick();
+	__enable_irq();
+
+	return 0;
+}
+
+/*
+ * give up on the transaction that has the bus, its status becomes I2C_ERROR
+ */
+void i2c_abort(void)
+{
+	__disable_irq();
+	if(i2c_busy())
+	{
+		/* stop IRQs & DMA before tidying up */
+		I2C1->CTLR2 &= ~I2C_CTLR2_ITALL;
+		DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+		i2c_finish(I2C_ERROR);
+	}
+	__enable_irq();
+}
+
+/*
+ * returns TRUE while x is waiting or running - gives up on whatever has the
+ * bus if it has had it too long
+ */
+uint8_t i2c_pending(I2C_XFER *x)
+{
+	if(x->status != I2C_PENDING)
+		return 0;
+	if(i2c_busy() && !SysTick_us_check(i2c_begun, I2C_TIMEOUT))
+		i2c_abort();
+	return x->status == I2C_PENDING;
+}
+
+/*
+ * bytes received so far when x is the read in progress
+ */
+uint16_t i2c_rx_count(I2C_XFER *x)
+{
+	if((x != i2c_cur) || (i2c_state != I2C_ST_READ))
+		return 0;
+	if(x->len >= I2C_DMA_MIN)
+		return x->len - DMA1_Channel7->CNTR;
+	return i2c_cnt;
+}
+
+/*
+ * free a slave stuck driving SDA low by clocking out the rest of its byte
+ * with the pins as GPIO, then send a STOP
+ */
+void i2c_recover(void)
+{
+	uint8_t i;
+
+	// take over the pins with both lines released
+	GPIOC->BSHR = (1<<1) | (1<<2);
+	i2c_pins(GPIO_CNF_OUT_OD);
+	Delay_Us(I2C_HALFBIT);
+
+	// up to 9 clocks until SDA is let go
+	for(i=0;(i<9) && !(GPIOC->INDR & (1<<1));i++)
+	{
+		GPIOC->BSHR = 1<<(16+2);
+		Delay_Us(I2C_HALFBIT);
+		GPIOC->BSHR = 1<<2;
+		Delay_Us(I2C_HALFBIT);
+	}
+
+	// STOP - SDA rises while SCL is high
+	GPIOC->BSHR = 1<<(16+2);
+	Delay_Us(I2C_HALFBIT);
+	GPIOC->BSHR = 1<<(16+1);
+	Delay_Us(I2C_HALFBIT);
+	GPIOC->BSHR = 1<<2;
+	Delay_Us(I2C_HALFBIT);
+	GPIOC->BSHR = 1<<1;
+	Delay_Us(I2C_HALFBIT);
+
+	// back to I2C
+	i2c_pins(GPIO_CNF_OUT_OD_AF);
+	i2c_recoveries++;
+}
+
+/*
+ * drop the running transaction, optionally recover the bus, re-init the
+ * port and carry on with the queue
+ */
+void i2c_reset(uint8_t recover)
+{
+	i2c_hold = 1;
+	i2c_abort();
+	if(recover)
+		i2c_recover();
+	i2c_setup();
+	i2c_hold = 0;
+
+	__disable_irq();
+	i2c_kick();
+	__enable_irq();
+}
+
+/*
+ * bus fault - fall back to standard mode and recover
+ */
+void i2c_fault(void)
+{
+	i2c_errors++;
+	if(i2c_rate > I2C_CLKRATE)
+	{
+		printf("i2c_fault - falling back to %d Hz\n\r", I2C_CLKRATE);
+		i2c_rate = I2C_CLKRATE;
+	}
+
+	i2c_reset(1);
+
+	printf("i2c_fault - errors %u retries %u recoveries %u\n\r",
+		(unsigned)i2c_errors, (unsigned)i2c_retries, (unsigned)i2c_recoveries);
+}
+
+/*
+ * change bus clock rate
+ */
+void i2c_speed(uint32_t rate)
+{
+	i2c_rate = rate;
+	i2c_reset(0);
+}
+
+/*
+ * blocking transaction, tried again after a fault - returns 1 on failure
+ */
+uint8_t i2c_xfer(uint8_t addr, uint8_t reg, uint8_t dir, uint8_t *buf, uint16_t len)
+{
+	I2C_XFER x;
+	uint8_t tries = I2C_TRIES;
+
+	x.addr = addr;
+	x.reg = reg;
+	x.dir = dir;
+	x.buf = buf;
+	x.len = len;
+	x.callback = NULL;
+	while(1)
+	{
+		if(!i2c_submit(&x))
+		{
+			while(i2c_pending(&x))
+			{
+				/* queued behind a fault nobody has reset yet */
+				if(i2c_hold && !i2c_busy())
+					i2c_reset(1);
+			}
+			if(x.status == I2C_DONE)
+				return 0;
+			i2c_fault();
+		}
+
+		if(!--tries)
+			return 1;
+		i2c_retries++;
+	}
+}
+
+/*
+ * blocking register write
+ */
+uint8_t i2c_write(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t sz)
+{
+	return i2c_xfer(addr, reg, I2C_WRITE, data, sz);
+}
+
+/*
+ * blocking register read
+ */
+uint8_t i2c_read(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t sz)
+{
+	return i2c_xfer(addr, reg, I2C_READ, data, sz);
+}
+
+/*
+ * I2C1 event IRQ walks the transaction state machine
+ * note - the __attribute__((interrupt)) syntax is crucial!
+ */
+void I2C1_EV_IRQHandler(void) __attribute__((interrupt));
+void I2C1_EV_IRQHandler(void)
+{
+	uint16_t star1 = I2C1->STAR1;
+	I2C_XFER *x = i2c_cur;
+
+	/* nothing going on - shouldn't happen */
+	if(!x)
+	{
+		I2C1->CTLR2 &= ~I2C_CTLR2_ITALL;
+		return;
+	}
+
+	if(star1 & I2C_STAR1_SB)
+	{
+		/* start done - send device address, read flag on the restart */
+		if(i2c_state == I2C_ST_RESTART)
+			I2C1->DATAR = (x->addr<<1) | 1;
+		else
+			I2C1->DATAR = x->addr<<1;
+	}
+	else if(star1 & I2C_STAR1_ADDR)
+	{
+		if(i2c_state == I2C_ST_RESTART)
+		{
+			i2c_state = I2C_ST_READ;
+			if(x->len >= I2C_DMA_MIN)
+			{
+				/* DMA takes it from here, events would steal bytes */
+				DMA1_Channel7->MADDR = (uint32_t)x->buf;
+				DMA1_Channel7->CNTR = x->len;
+				DMA1_Channel7->CFGR = DMA_CFGR1_MINC | DMA_CFGR1_TCIE |
+					DMA_CFGR1_TEIE | DMA_CFGR1_EN;
+				I2C1->CTLR2 = (I2C1->CTLR2 & ~I2C_CTLR2_ITEVTEN) |
+					I2C_CTLR2_DMAEN | I2C_CTLR2_LAST;
+				(void)I2C1->STAR2;
+				return;
+			}
+
+			/* single byte must be NACKed & stopped before ADDR clears */
+			if(x->len == 1)
+			{
+				I2C1->CTLR1 &= CTLR1_ACK_Reset;
+				(void)I2C1->STAR2;
+				I2C1->CTLR1 |= I2C_CTLR1_STOP;
+			}
+			else
+				(void)I2C1->STAR2;
+			I2C1->CTLR2 |= I2C_CTLR2_ITBUFEN;
+		}
+		else
+		{
+			/* register address goes out first */
+			(void)I2C1->STAR2;
+			I2C1->DATAR = x->reg;
+			i2c_state = I2C_ST_WRITE;
+
+			/* TXE feeds write data, otherwise just wait for BTF */
+			if((x->dir == I2C_WRITE) && x->len)
+				I2C1->CTLR2 |= I2C_CTLR2_ITBUFEN;
+			else
+				I2C1->CTLR2 &= ~I2C_CTLR2_ITBUFEN;
+		}
+	}
+	else if(i2c_state == I2C_ST_READ)
+	{
+		if(star1 & I2C_STAR1_RXNE)
+		{
+			/* only single bytes get here, already NACKed & stopped */
+			x->buf[i2c_cnt++] = I2C1->DATAR;
+			if(i2c_cnt == x->len)
+				i2c_finish(I2C_DONE);
+		}
+	}
+	else if(i2c_state == I2C_ST_WRITE)
+	{
+		if((star1 & I2C_STAR1_TXE) && (x->dir == I2C_WRITE) && (i2c_cnt < x->len))
+		{
+			I2C1->DATAR = x->buf[i2c_cnt++];
+
+			/* last one queued - wait for BTF */
+			if(i2c_cnt == x->len)
+				I2C1->CTLR2 &= ~I2C_CTLR2_ITBUFEN;
+		}
+		else if(star1 & I2C_STAR1_BTF)
+		{
+			if(x->dir == I2C_READ)
+			{
+				/* turn the bus around */
+				i2c_state = I2C_ST_RESTART;
+				I2C1->CTLR1 |= I2C_CTLR1_START;
+			}
+			else
+			{
+				I2C1->CTLR1 |= I2C_CTLR1_STOP;
+				i2c_finish(I2C_DONE);
+			}
+		}
+	}
+}
+
+/*
+ * I2C1 error IRQ aborts the transaction
+ * note - the __attribute__((interrupt)) syntax is crucial!
+ */
+void I2C1_ER_IRQHandler(void) __attribute__((interrupt));
+void I2C1_ER_IRQHandler(void)
+{
+	uint16_t star1 = I2C1->STAR1;
+
+	/* error flags clear by writing zero */
+	I2C1->STAR1 = ~(star1 & I2C_STAR1_ERRORS);
+
+	/* release the bus */
+	I2C1->CTLR1 |= I2C_CTLR1_STOP;
+
+	if(i2c_cur)
+	{
+		i2c_cur->err = star1 & I2C_STAR1_ERRORS;
+		i2c_finish(I2C_ERROR);
+	}
+	else
+		I2C1->CTLR2 &= ~I2C_CTLR2_ITALL;
+}
+
+/*
+ * DMA channel 7 IRQ ends a DMA read - LAST has NACKed the final byte
+ * note - the __attribute__((interrupt)) syntax is crucial!
+ */
+void DMA1_Channel7_IRQHandler(void) __attribute__((interrupt));
+void DMA1_Channel7_IRQHandler(void)
+{
+	uint32_t intfr = DMA1->INTFR;
+
+	DMA1->INTFCR = DMA_CGIF7;
+	I2C1->CTLR1 |= I2C_CTLR1_STOP;
+
+	if(i2c_cur)
+	{
+		if(intfr & DMA_TEIF7)
+		{
+			i2c_cur->err = I2C_ERR_DMA;
+			i2c_finish(I2C_ERROR);
+		}
+		else
+			i2c_finish(I2C_DONE);
+	}
+	else
+		DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+}
+
+/*
+ * init the GPIO port, the I2C port, its IRQs & DMA
+ */
+void i2c_init(void)
+{
+	// Enable GPIOC, I2C and DMA
+	RCC->APB1PCENR |= RCC_APB1Periph_I2C1;
+	RCC->APB2PCENR |= RCC_APB2Periph_GPIOC | RCC_APB2Periph_AFIO;
+	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
+
+	// PC1 is SDA, PC2 is SCL, 10MHz Output, alt func, open-drain
+	i2c_pins(GPIO_CNF_OUT_OD_AF);
+
+	// init the I2C port
+	i2c_cur = NULL;
+	i2c_state = I2C_ST_IDLE;
+	i2c_head = i2c_tail = 0;
+	i2c_hold = 0;
+	i2c_setup();
+
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+
+	/* DMA channel 7 is I2C1 RX */
+	DMA1_Channel7->CFGR = 0;
+	DMA1_Channel7->PADDR = (uint32_t)&I2C1->DATAR;
+	NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+}
+
+#endif
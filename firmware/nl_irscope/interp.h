@@ -0,0 +1,130 @@
+/*
+ * interp.h - single-file header for fixed-point bilinear upscale of 8x8 array
+ * 10-19-26 E. Brombaugh
+ *
+ * Output pixel centers are mapped back onto the source grid so each source
+ * element sits in the middle of its 10x10 block. Edges past the outer
+ * centers are held. Both passes are DDAs stepping 1/10 of the difference
+ * between neighbors, so the only multiplies happen once per 10x10 block.
+ */
+
+#ifndef __interp__
+#define __interp__
+
+#define INTERP_SRC 8
+#define INTERP_SCALE 10
+#define INTERP_DST (INTERP_SRC*INTERP_SCALE)
+#define INTERP_FRAC 4		// fractional bits in output values
+
+// 1/INTERP_SCALE in Q16
+#define INTERP_RECIP 6554
+
+typedef struct
+{
+	int16_t *src;					// 8x8 source, row-major
+	int32_t acc[INTERP_SRC];		// vertical DDA per column, Q12
+	int32_t step[INTERP_SRC];		// vertical increment per row, Q12
+	uint8_t seg;					// 0 = top edge, INTERP_SRC = bottom edge
+	uint8_t cnt;					// output rows left in current segment
+} INTERP_STATE;
+
+/*
+ * load vertical DDA for the current segment
+ */
+void interp_segment(INTERP_STATE *is)
+{
+	int16_t *top;
+	int32_t d;
+	uint8_t c;
+
+	if((is->seg == 0) || (is->seg == INTERP_SRC))
+	{
+		/* hold edge row for half a block */
+		top = &is->src[(is->seg ? INTERP_SRC-1 : 0)*INTERP_SRC];
+		for(c=0;c<INTERP_SRC;c++)
+		{
+			is->acc[c] = (int32_t)top[c] << 12;
+			is->step[c] = 0;
+		}
+		is->cnt = INTERP_SCALE/2;
+	}
+	else
+	{
+		/* first output row is half a step past the upper source center */
+		top = &is->src[(is->seg-1)*INTERP_SRC];
+		for(c=0;c<INTERP_SRC;c++)
+		{
+			d = top[c+INTERP_SRC] - top[c];
+			is->step[c] = (d * INTERP_RECIP) >> 4;
+			is->acc[c] = ((int32_t)top[c] << 12) + (is->step[c]>>1);
+		}
+		is->cnt = INTERP_SCALE;
+	}
+}
+
+/*
+ * source rows needed before output row y can be generated
+ */
+uint8_t interp_src_rows(uint8_t y)
+{
+	uint8_t seg = y < INTERP_SCALE/2 ? 0 : (y - INTERP_SCALE/2)/INTERP_SCALE + 1;
+
+	return seg < INTERP_SRC ? seg+1 : INTERP_SRC;
+}
+
+/*
+ * start a new frame
+ */
+void interp_start(INTERP_STATE *is, int16_t *src)
+{
+	is->src = src;
+	is->seg = 0;
+	interp_segment(is);
+}
+
+/*
+ * generate the next output row - line holds INTERP_DST values with
+ * INTERP_FRAC fractional bits
+ */
+void interp_row(INTERP_STATE *is, int16_t *line)
+{
+	int32_t hacc, hstep, v0, v1;
+	uint8_t c, i;
+
+	/* move to next segment when current one is used up */
+	if(!is->cnt)
+	{
+		is->seg++;
+		interp_segment(is);
+	}
+
+	/* left edge */
+	v0 = is->acc[0] >> (12-INTERP_FRAC);
+	for(i=0;i<INTERP_SCALE/2;i++)
+		*line++ = v0;
+
+	/* interior - horizontal DDA in Q8 of the output format */
+	for(c=1;c<INTERP_SRC;c++)
+	{
+		v1 = is->acc[c] >> (12-INTERP_FRAC);
+		hstep = ((v1 - v0) * INTERP_RECIP) >> 8;
+		hacc = (v0 << 8) + (hstep>>1);
+		for(i=0;i<INTERP_SCALE;i++)
+		{
+			*line++ = hacc >> 8;
+			hacc += hstep;
+		}
+		v0 = v1;
+	}
+
+	/* right edge */
+	for(i=0;i<INTERP_SCALE/2;i++)
+		*line++ = v0;
+
+	/* advance vertical DDA */
+	for(c=0;c<INTERP_SRC;c++)
+		is->acc[c] += is->step[c];
+	is->cnt--;
+}
+
+#endif
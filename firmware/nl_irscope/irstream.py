@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+irstream.py - record & replay nl_irscope binary frame streams
+10-19-26 E. Brombaugh
+
+Frames come out of the debug port mixed in with the usual printf text, so
+pipe the terminal output of minichlink in to record them:
+
+    minichlink -T | ./irstream.py record scene.irs
+
+Packets that pass their CRC are written to the file unchanged and anything
+else is passed through to stderr. A recording is replayed as grids of
+temperatures, or as CSV for analysis:
+
+    ./irstream.py replay scene.irs
+    ./irstream.py replay --csv scene.irs > scene.csv
+
+See stream.h for the packet layout.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = b"IR"
+PIX = 6
+CRC = PIX + 96
+LEN = CRC + 2
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE"""
+    crc = 0xffff
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xffff
+    return crc
+
+
+def decode(pkt):
+    """returns (seq, thermistor C, list of 64 element temperatures in C)"""
+    seq, therm = struct.unpack_from("<HH", pkt, 2)
+    tc = (therm & 0x7ff) * 0.0625
+    if therm & 0x800:
+        tc = -tc
+    pix = []
+    for i in range(PIX, CRC, 3):
+        b0, b1, b2 = pkt[i:i+3]
+        for v in (b0 | ((b1 & 0x0f) << 8), (b1 >> 4) | (b2 << 4)):
+            if v & 0x800:
+                v -= 0x1000
+            pix.append(v * 0.25)
+    return seq, tc, pix
+
+
+def packets(stream, text=None):
+    """yield good packets from a byte stream, sending the rest to text"""
+    buf = bytearray()
+    while True:
+        data = stream.read1(4096) if hasattr(stream, "read1") else stream.read(4096)
+        if not data:
+            break
+        buf += data
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                keep = 1 if buf[-1:] == SYNC[:1] else 0
+                if text:
+                    text.write(buf[:len(buf)-keep].decode("latin-1"))
+                del buf[:len(buf)-keep]
+                break
+            if len(buf) - i < LEN:
+                if text and i:
+                    text.write(buf[:i].decode("latin-1"))
+                del buf[:i]
+                break
+            pkt = bytes(buf[i:i+LEN])
+            if crc16(pkt[2:CRC]) == struct.unpack_from("<H", pkt, CRC)[0]:
+                if text and i:
+                    text.write(buf[:i].decode("latin-1"))
+                del buf[:i+LEN]
+                yield pkt
+            else:
+                # not a packet after all - sync was in the text
+                if text:
+                    text.write(buf[:i+1].decode("latin-1"))
+                del buf[:i+1]
+        if text:
+            text.flush()
+
+
+def record(args):
+    src = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    last = None
+    n = 0
+    with open(args.output, "wb") as out:
+        try:
+            for pkt in packets(src, sys.stderr):
+                seq = struct.unpack_from("<H", pkt, 2)[0]
+                if last is not None and seq != (last + 1) & 0xffff:
+                    sys.stderr.write("\n[gap of %d frames]\n" % ((seq - last - 1) & 0xffff))
+                last = seq
+                out.write(pkt)
+                out.flush()
+                n += 1
+        except KeyboardInterrupt:
+            pass
+    sys.stderr.write("\n%d frames recorded to %s\n" % (n, args.output))
+
+
+def replay(args):
+    with open(args.input, "rb") as f:
+        for pkt in packets(f):
+            seq, tc, pix = decode(pkt)
+            if args.csv:
+                print(",".join([str(seq), "%.4f" % tc] + ["%.2f" % p for p in pix]))
+                continue
+            print("frame %d  thermistor %.2fC" % (seq, tc))
+            for y in range(8):
+                print(" ".join("%6.2f" % p for p in pix[y*8:y*8+8]))
+            print()
+            if args.rate:
+                time.sleep(1.0 / args.rate)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="record & replay nl_irscope frame streams")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    rp = sub.add_parser("record", help="pull good packets out of a debug stream")
+    rp.add_argument("output", help="recording to write")
+    rp.add_argument("input", nargs="?", default="-", help="debug stream, default stdin")
+    rp.set_defaults(func=record)
+
+    pp = sub.add_parser("replay", help="print the frames of a recording")
+    pp.add_argument("input", help="recording to read")
+    pp.add_argument("--csv", action="store_true", help="seq, thermistor & 64 elements per line")
+    pp.add_argument("--rate", type=float, default=0, help="frames per second, default as fast as possible")
+    pp.set_defaults(func=replay)
+
+    args = ap.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
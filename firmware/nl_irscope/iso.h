@@ -0,0 +1,49 @@
+/*
+ * iso.h - single-file header for isotherm highlighting & over-temperature alarm
+ * 10-19-26 E. Brombaugh
+ *
+ * Elements at or above the chosen temperature are drawn in a highlight color
+ * instead of the color map. The threshold is converted to raw sensor units,
+ * with and without the interpolation fraction bits, once when it's chosen so
+ * the render loops only compare. The alarm is raised by any highlighted
+ * element and cleared by a frame without one.
+ */
+
+#ifndef __iso__
+#define __iso__
+
+#define ISO_COLOR GFX_MAGENTA
+#define ISO_IDX 255				// color index marking highlighted pixels
+
+/* band choices in C */
+const int16_t iso_temps[] =
+{
+	0, 30, 40, 60, 100
+};
+
+int16_t iso_raw;				// threshold in raw units
+int16_t iso_lin;				// same with INTERP_FRAC fraction bits
+uint16_t iso_color;				// native highlight color
+uint8_t iso_on, iso_hit, iso_alarm;
+
+/*
+ * choose a band - 0 is off
+ */
+void iso_set(uint8_t band)
+{
+	iso_on = band != 0;
+	iso_raw = iso_temps[band] << 2;
+	iso_lin = iso_raw << INTERP_FRAC;
+	iso_color = gfx_getcolor(ISO_COLOR);
+}
+
+/*
+ * start with no band & no alarm
+ */
+void iso_init(void)
+{
+	iso_set(0);
+	iso_hit = iso_alarm = 0;
+}
+
+#endif
@@ -177,13 +177,13 @@ const static uint16_t
 };
 
 /* LCD state */
-uint8_t rowstart, colstart;
+uint8_t rowstart, colstart, madctl;
 uint16_t _width, _height, rotation;
 	
 /*
  * packet send for blocking polled operation via spi
  */
-uint8_t lcd_pkt_send(uint8_t *data, uint8_t sz)
+uint8_t lcd_pkt_send(uint8_t *data, uint16_t sz)
 {
 	// send data
 	while(sz--)
@@ -363,18 +363,61 @@ void lcd_bitblt(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *buf)
 	LCD_CS_HIGH();
 }
 
+// bitblt a region of palette indices to the display - cannot clip here so
+// caller must clip. Indices are 1/2/4/8 bpp, packed MSB first with each row
+// starting on a byte boundary. Palette entries are in native 16-bit format.
+void lcd_bitblt_idx(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t *buf,
+	uint8_t bpp, const uint16_t *pal)
+{
+	uint8_t mask = (1<<bpp)-1, d = 0, shift;
+	uint16_t color;
+	int16_t i;
+	
+	lcd_setAddrWindow(x, y, x+w-1, y+h-1);
+
+	LCD_DC_DATA();
+	LCD_CS_LOW();
+
+	/* expand through palette while the previous byte is shifting out */
+	while(h--)
+	{
+		shift = 0;
+		for(i=0;i<w;i++)
+		{
+			/* next byte of indices */
+			if(!shift)
+			{
+				d = *buf++;
+				shift = 8;
+			}
+			shift -= bpp;
+			color = pal[(d>>shift)&mask];
+			
+			/* low byte first, same as 16-bit buffer in memory */
+			while(!(SPI1->STATR & SPI_STATR_TXE));
+			SPI1->DATAR = color & 0xff;
+			while(!(SPI1->STATR & SPI_STATR_TXE));
+			SPI1->DATAR = color >> 8;
+		}
+	}
+	
+	// wait for not busy before exiting
+	while(SPI1->STATR & SPI_STATR_BSY);
+
+	LCD_CS_HIGH();
+}
+
 
 /*
  * set orientation of display
  */
 void lcd_setRotation(uint8_t m)
 {
-	lcd_write_byte(ST77XX_MADCTL | ST_CMD);
 	rotation = m % 4; // can't be higher than 3
 	switch (rotation)
 	{
 		case 0:
-			lcd_write_byte(ST77XX_MADCTL_RGB | ST77XX_MADCTL_MX | ST77XX_MADCTL_MY );
+			madctl = ST77XX_MADCTL_RGB | ST77XX_MADCTL_MX | ST77XX_MADCTL_MY;
 			_width  = ST7735_TFTWIDTH;
 			_height = ST7735_TFTHEIGHT;
 			rowstart = ST7735_ROWSTRT;
@@ -382,7 +425,7 @@ void lcd_setRotation(uint8_t m)
 			break;
 
 		case 1:
-			lcd_write_byte(ST77XX_MADCTL_RGB | ST77XX_MADCTL_MY | ST77XX_MADCTL_MV );
+			madctl = ST77XX_MADCTL_RGB | ST77XX_MADCTL_MY | ST77XX_MADCTL_MV;
 			_width  = ST7735_TFTHEIGHT;
 			_height = ST7735_TFTWIDTH;
 			rowstart = ST7735_COLSTRT;
@@ -390,7 +433,7 @@ void lcd_setRotation(uint8_t m)
 			break;
 
 		case 2:
-			lcd_write_byte(ST77XX_MADCTL_RGB | 0);
+			madctl = ST77XX_MADCTL_RGB | 0;
 			_width  = ST7735_TFTWIDTH;
 			_height = ST7735_TFTHEIGHT;
 			rowstart = ST7735_ROWSTRT;
@@ -398,13 +441,90 @@ void lcd_setRotation(uint8_t m)
 			break;
 
 		case 3:
-			lcd_write_byte(ST77XX_MADCTL_RGB | ST77XX_MADCTL_MX | ST77XX_MADCTL_MV );
+			madctl = ST77XX_MADCTL_RGB | ST77XX_MADCTL_MX | ST77XX_MADCTL_MV;
 			_width  = ST7735_TFTHEIGHT;
 			_height = ST7735_TFTWIDTH;
 			rowstart = ST7735_COLSTRT;
 			colstart = ST7735_ROWSTRT;
 			break;
 	}
+	lcd_write_byte(ST77XX_MADCTL | ST_CMD);
+	lcd_write_byte(madctl);
+}
+
+/*
+ * bitblt with a temporary change of scan direction so the buffer is sent in
+ * its natural order. Buffer is w x h, footprint on screen at x,y is h x w when
+ * transposed. Mirrors are applied to the footprint after any transpose.
+ * Relies on the panel offsets being symmetric so flipped windows stay put.
+ * Cannot clip here so caller must clip.
+ */
+void lcd_bitblt_orient(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *buf,
+	uint8_t orient)
+{
+	uint8_t mad = madctl;
+	int16_t x0, y0, x1, y1, tmp;
+	
+	/* footprint on screen */
+	x0 = x;
+	y0 = y;
+	if(orient & GFX_ORIENT_XY)
+	{
+		x1 = x+h-1;
+		y1 = y+w-1;
+	}
+	else
+	{
+		x1 = x+w-1;
+		y1 = y+h-1;
+	}
+	
+	/* flip the axis that feeds screen x & move window to the flipped side */
+	if(orient & GFX_ORIENT_MIRX)
+	{
+		mad ^= (madctl & ST77XX_MADCTL_MV) ? ST77XX_MADCTL_MY : ST77XX_MADCTL_MX;
+		tmp = x0;
+		x0 = _width-1-x1;
+		x1 = _width-1-tmp;
+	}
+	
+	/* same for screen y */
+	if(orient & GFX_ORIENT_MIRY)
+	{
+		mad ^= (madctl & ST77XX_MADCTL_MV) ? ST77XX_MADCTL_MX : ST77XX_MADCTL_MY;
+		tmp = y0;
+		y0 = _height-1-y1;
+		y1 = _height-1-tmp;
+	}
+	
+	/* exchange row/col - window and panel offsets trade places too */
+	if(orient & GFX_ORIENT_XY)
+	{
+		mad ^= ST77XX_MADCTL_MV;
+		tmp = x0; x0 = y0; y0 = tmp;
+		tmp = x1; x1 = y1; y1 = tmp;
+		tmp = colstart; colstart = rowstart; rowstart = tmp;
+	}
+	
+	lcd_write_byte(ST77XX_MADCTL | ST_CMD);
+	lcd_write_byte(mad);
+	lcd_setAddrWindow(x0, y0, x1, y1);
+
+	LCD_DC_DATA();
+	LCD_CS_LOW();
+
+	/* PIO buffer send */
+	lcd_pkt_send((uint8_t *)buf, 2*w*h);
+
+	LCD_CS_HIGH();
+	
+	/* restore original orientation */
+	if(orient & GFX_ORIENT_XY)
+	{
+		tmp = colstart; colstart = rowstart; rowstart = tmp;
+	}
+	lcd_write_byte(ST77XX_MADCTL | ST_CMD);
+	lcd_write_byte(madctl);
 }
 
 /*
@@ -495,7 +615,7 @@ void lcd_init(void)
 }
 
 /* high level driver interface */
-GFX_DRIVER ST7735_drvr =
+const GFX_DRIVER ST7735_drvr =
 {
 	ST7735_TFTHEIGHT,
 	ST7735_TFTWIDTH,
@@ -505,6 +625,8 @@ GFX_DRIVER ST7735_drvr =
     lcd_ColorRGB,
 	lcd_fillRect,
 	lcd_drawPixel,
-	lcd_bitblt
+	lcd_bitblt,
+	lcd_bitblt_idx,
+	lcd_bitblt_orient
 };
 #endif
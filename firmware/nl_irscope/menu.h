@@ -11,12 +11,93 @@
 #include "gfx.h"
 #include "systick.h"
 
-#define MNU_NUM_ITEMS 4
 #define MNU_YSPACE 10
-#define MNU_YSTART 2
+#define MNU_YSTART 3
 #define MNU_XSTART 92
+#define MNU_ROWS 3
+#define MNU_STRLEN 4
 
-int8_t menu_item, prev_menu_item, menu_item_vals[MNU_NUM_ITEMS];
+/* last filter choice uses sensor averaging, others are 2^n frames */
+#define FLT_SENSOR 5
+
+/* optional items come & go with the feature switches in nl_irscope.c */
+enum menu_items
+{
+	MNU_DEG,
+	MNU_CLR,
+	MNU_OFF,
+	MNU_AMP,
+	MNU_INT,
+	MNU_MAP,
+	MNU_FLT,
+	MNU_I2C,
+#ifdef WATCH
+	MNU_WCH,
+#endif
+#ifdef POWER
+	MNU_PWR,
+#endif
+#ifdef TRACKER
+	MNU_TRK,
+#endif
+	MNU_ROI,
+#ifdef NUC
+	MNU_NUC,
+	MNU_EMS,
+#endif
+#ifdef PRESENCE
+	MNU_PRS,
+#endif
+#ifdef HISTORY
+	MNU_HIS,
+#endif
+#ifdef STREAM
+	MNU_STR,
+#endif
+#ifdef ISO
+	MNU_ISO,
+	MNU_ALM,
+#endif
+	MNU_NUM_ITEMS,
+
+	/* items of features left out of the build are never shown & stay 0 */
+#ifndef WATCH
+	MNU_WCH,
+#endif
+#ifndef POWER
+	MNU_PWR,
+#endif
+#ifndef TRACKER
+	MNU_TRK,
+#endif
+#ifndef NUC
+	MNU_NUC,
+	MNU_EMS,
+#endif
+#ifndef PRESENCE
+	MNU_PRS,
+#endif
+#ifndef HISTORY
+	MNU_HIS,
+#endif
+#ifndef STREAM
+	MNU_STR,
+#endif
+#ifndef ISO
+	MNU_ISO,
+	MNU_ALM,
+#endif
+	MNU_ALL_ITEMS
+};
+
+enum menu_types
+{
+	MNU_TYPE_NUM,	// signed value
+	MNU_TYPE_CHR,	// one letter per choice, current one highlighted
+	MNU_TYPE_STR,	// MNU_STRLEN letters per choice, only current shown
+};
+
+int8_t menu_item, prev_menu_item, menu_top, menu_item_vals[MNU_ALL_ITEMS];
 char textbuf[16];	
 
 const char *menu_item_names[MNU_NUM_ITEMS] =
@@ -25,42 +106,228 @@ const char *menu_item_names[MNU_NUM_ITEMS] =
 	"clr",
 	"off",
 	"amp",
+	"int",
+	"map",
+	"flt",
+	"i2c",
+#ifdef WATCH
+	"wch",
+#endif
+#ifdef POWER
+	"pwr",
+#endif
+#ifdef TRACKER
+	"trk",
+#endif
+	"roi",
+#ifdef NUC
+	"nuc",
+	"ems",
+#endif
+#ifdef PRESENCE
+	"prs",
+#endif
+#ifdef HISTORY
+	"his",
+#endif
+#ifdef STREAM
+	"str",
+#endif
+#ifdef ISO
+	"iso",
+	"alm",
+#endif
 };
 
 const int8_t menu_item_limits[2*MNU_NUM_ITEMS] =
 {
 	0, 1,
-	0, 3,
+	0, 5,
 	-10, 20,
 	0, 5,
+	0, 1,
+	0, 2,
+	0, FLT_SENSOR,
+	0, 1,
+#ifdef WATCH
+	0, 1,
+#endif
+#ifdef POWER
+	0, 1,
+#endif
+#ifdef TRACKER
+	0, 1,
+#endif
+	0, 3,
+#ifdef NUC
+	0, 2,
+	0, 7,
+#endif
+#ifdef PRESENCE
+	0, 1,
+#endif
+#ifdef HISTORY
+	0, 1,
+#endif
+#ifdef STREAM
+	0, 1,
+#endif
+#ifdef ISO
+	0, 4,
+	0, 1,
+#endif
+};
+
+const uint8_t menu_item_types[MNU_NUM_ITEMS] =
+{
+	MNU_TYPE_CHR,
+	MNU_TYPE_STR,
+	MNU_TYPE_NUM,
+	MNU_TYPE_NUM,
+	MNU_TYPE_STR,
+	MNU_TYPE_STR,
+	MNU_TYPE_STR,
+	MNU_TYPE_STR,
+#ifdef WATCH
+	MNU_TYPE_STR,
+#endif
+#ifdef POWER
+	MNU_TYPE_STR,
+#endif
+#ifdef TRACKER
+	MNU_TYPE_STR,
+#endif
+	MNU_TYPE_STR,
+#ifdef NUC
+	MNU_TYPE_STR,
+	MNU_TYPE_STR,
+#endif
+#ifdef PRESENCE
+	MNU_TYPE_STR,
+#endif
+#ifdef HISTORY
+	MNU_TYPE_STR,
+#endif
+#ifdef STREAM
+	MNU_TYPE_STR,
+#endif
+#ifdef ISO
+	MNU_TYPE_STR,
+	MNU_TYPE_STR,
+#endif
 };
 
-const char clr[4] =
+const char *menu_item_choices[MNU_NUM_ITEMS] =
 {
-	'R', 'G', 'B', 'W',
+	"CF",
+	"red grn blu grayironrnbw",
+	NULL,
+	NULL,
+	"blk lin ",
+	"man autoheq ",
+	"off t2  t4  t8  t16 ave ",
+	"100k400k",
+#ifdef WATCH
+	"off on  ",
+#endif
+#ifdef POWER
+	"fullauto",
+#endif
+#ifdef TRACKER
+	"off on  ",
+#endif
+	"1x1 2x2 3x3 4x4 ",
+#ifdef NUC
+	"off on  cap ",
+	"1.00.95 .90 .85 .80 .70 .60 .50 ",
+#endif
+#ifdef PRESENCE
+	"off on  ",
+#endif
+#ifdef HISTORY
+	"livefrz ",
+#endif
+#ifdef STREAM
+	"off on  ",
+#endif
+#ifdef ISO
+	"off 30C 40C 60C 100C",
+	"off on  ",
+#endif
 };
 
+/*
+ * draw the value of one item on its row
+ */
+void menu_render_val(uint8_t i, int16_t y)
+{
+	const char *choices = menu_item_choices[i];
+	uint8_t n, c;
+
+	switch(menu_item_types[i])
+	{
+		case MNU_TYPE_CHR:
+			/* spread the letters over the value field */
+			n = strlen(choices);
+			for(c=0;c<n;c++)
+			{
+				gfx_set_txtmode(c==menu_item_vals[i] ? GFX_TXTREV : GFX_TXTNORM);
+				gfx_drawchar(MNU_XSTART+32+(8*MNU_STRLEN/n)*c, y, choices[c]);
+			}
+			gfx_set_txtmode(GFX_TXTNORM);
+			break;
+
+		case MNU_TYPE_STR:
+			memcpy(textbuf, &choices[MNU_STRLEN*menu_item_vals[i]], MNU_STRLEN);
+			textbuf[MNU_STRLEN] = 0;
+			gfx_drawstr(MNU_XSTART+32, y, textbuf);
+			break;
+
+		case MNU_TYPE_NUM:
+		default:
+			sprintf(textbuf, "%-4d", menu_item_vals[i]);
+			gfx_drawstr(MNU_XSTART+32, y, textbuf);
+			break;
+	}
+}
+
 /*
  * draw the menu
  */
-void menu_render(uint8_t mask)
+void menu_render(uint32_t mask)
 {
-	uint8_t itembit = 1;
+	uint32_t itembit = 1;
 	GFX_RECT rect;
+	int16_t y;
+
+	/* scroll to keep the current item visible */
+	if(menu_item < menu_top)
+	{
+		menu_top = menu_item;
+		mask = 0xffffffff;
+	}
+	else if(menu_item >= menu_top + MNU_ROWS)
+	{
+		menu_top = menu_item - MNU_ROWS + 1;
+		mask = 0xffffffff;
+	}
 	
 	/* update item selector */
 	if(menu_item != prev_menu_item)
 	{
-		/* erase previous */
-		rect.y0 = (prev_menu_item+MNU_YSTART)*MNU_YSPACE-1;
-		rect.y1 = rect.y0 + (MNU_YSPACE-1);
+		/* erase previous if still on screen */
 		rect.x0 = MNU_XSTART-1;
 		rect.x1 = 159;
-		gfx_set_forecolor(GFX_BLACK);
-		gfx_drawrect(&rect);
+		if((prev_menu_item >= menu_top) && (prev_menu_item < menu_top + MNU_ROWS))
+		{
+			rect.y0 = (prev_menu_item-menu_top+MNU_YSTART)*MNU_YSPACE-1;
+			rect.y1 = rect.y0 + (MNU_YSPACE-1);
+			gfx_set_forecolor(GFX_BLACK);
+			gfx_drawrect(&rect);
+		}
 		
 		/* draw current */
-		rect.y0 = (menu_item+MNU_YSTART)*MNU_YSPACE-1;
+		rect.y0 = (menu_item-menu_top+MNU_YSTART)*MNU_YSPACE-1;
 		rect.y1 = rect.y0 + (MNU_YSPACE-1);
 		gfx_set_forecolor(GFX_WHITE);
 		gfx_drawrect(&rect);
@@ -68,44 +335,25 @@ void menu_render(uint8_t mask)
 		prev_menu_item = menu_item;
 	}
 	
-	/* update all marked items */
+	/* update all marked items that are on screen */
 	for(int i=0;i<MNU_NUM_ITEMS;i++)
 	{
-		if(mask & itembit)
+		if((mask & itembit) && (i >= menu_top) && (i < menu_top + MNU_ROWS))
 		{
-			gfx_drawstr(MNU_XSTART, (i+MNU_YSTART)*MNU_YSPACE, (char *)menu_item_names[i]);
-			switch(i)
+			y = (i-menu_top+MNU_YSTART)*MNU_YSPACE;
+
+			/* full redraw clears the value field first */
+			if(mask == 0xffffffff)
 			{
-				case 0:	/* degree scale */
-					gfx_set_txtmode(menu_item_vals[i] ? GFX_TXTNORM : GFX_TXTREV);
-					gfx_drawstr(MNU_XSTART+32, (i+MNU_YSTART)*MNU_YSPACE, "C");
-					gfx_set_txtmode(!menu_item_vals[i] ? GFX_TXTNORM : GFX_TXTREV);
-					gfx_drawstr(MNU_XSTART+48, (i+MNU_YSTART)*MNU_YSPACE, "F");
-					gfx_set_txtmode(GFX_TXTNORM);
-					break;
-				
-				case 1: /* color scale */
-					for(int c=0;c<4;c++)
-					{
-						if(c==menu_item_vals[i])
-							gfx_set_txtmode(GFX_TXTREV);
-						else
-							gfx_set_txtmode(GFX_TXTNORM);
-						gfx_drawchar(MNU_XSTART+32+8*c, (i+MNU_YSTART)*MNU_YSPACE, clr[c]);
-					}
-					gfx_set_txtmode(GFX_TXTNORM);
-					break;
-				
-				case 2:	/* offset */
-					
-					//break;
-				
-				case 3: /* gain */
-					sprintf(textbuf, "%d ", menu_item_vals[i]);
-					gfx_drawstr(MNU_XSTART+32, (i+MNU_YSTART)*MNU_YSPACE, textbuf);
-					break;
-			
+				rect.x0 = MNU_XSTART+32;
+				rect.x1 = rect.x0 + 8*MNU_STRLEN - 1;
+				rect.y0 = y;
+				rect.y1 = y+7;
+				gfx_clrrect(&rect);
 			}
+				
+			gfx_drawstr(MNU_XSTART, y, (char *)menu_item_names[i]);
+			menu_render_val(i, y);
 		}
 		itembit <<=1 ;
 	}
@@ -117,19 +365,20 @@ void menu_render(uint8_t mask)
 void menu_init(void)
 {
 	menu_item = 0;
-	prev_menu_item = 3;	// to force redraw at start
+	menu_top = 0;
+	prev_menu_item = MNU_ROWS-1;	// to force redraw at start
 	for(int i=0;i<MNU_NUM_ITEMS;i++)
 		menu_item_vals[i] = menu_item_limits[2*i];
 	
-	menu_render(0xff);
+	menu_render(0xffffffff);
 }
 
 /*
- * process the menu
+ * process the menu - returns mask of items that changed value
  */
-void menu_proc(void)
+uint32_t menu_proc(void)
 {
-	uint8_t mask = 0;
+	uint32_t mask = 0;
 	
 	/* select item */
 	if(SysTick_get_button(BTN_UP))
@@ -162,6 +411,8 @@ void menu_proc(void)
 	}
 	
 	menu_render(mask);
+
+	return mask;
 }
 
 #endif
\ No newline at end of file
@@ -31,13 +31,46 @@
 /* uncomment this to try pwm hue */
 #define HUE
 
+/* uncomment this to report render time in core clocks */
+//#define BENCH
+
+/*
+ * optional features - together they're too big for the 16kB of flash and
+ * can't all be built at once, see the README. Uncomment the ones wanted;
+ * nl_irscope.ld fails the link if they don't fit.
+ */
+#define WATCH			// wake on the sensor's interrupt flag
+//#define POWER			// slow down & sleep on a still scene
+//#define TRACKER		// hot & cold spot crosshairs
+//#define NUC			// offset correction & emissivity
+//#define PRESENCE		// presence detection & counting
+//#define HISTORY		// frame history & replay
+//#define STREAM		// binary frame streaming
+#define ISO				// isotherm highlighting & alarm
+
 #include "ch32fun.h"
 #include <stdio.h>
 #include <string.h>
 #include "systick.h"
 #include "gfx.h"
 #include "lcd.h"
+#include "i2c.h"
 #include "amg8833.h"
+#include "interp.h"
+#include "palette.h"
+#include "agc.h"
+#include "heq.h"
+#include "filter.h"
+#include "stats.h"
+#include "sched.h"
+#include "power.h"
+#include "tracker.h"
+#include "roi.h"
+#include "nuc.h"
+#include "presence.h"
+#include "history.h"
+#include "stream.h"
+#include "iso.h"
 #include "menu.h"
 
 /* build version in simple format */
@@ -47,6 +80,50 @@ const char *fwVersionStr = "V1.0";
 const char *bdate = __DATE__;
 const char *btime = __TIME__;
 
+/* strip chart of thermistor & spot temp in 0.25C units */
+#define CHART_TMIN (15*4)
+#define CHART_TMAX (40*4)
+#define CHART_DECIM 5
+#define CHART_WIDTH (160-(MNU_XSTART-1))
+GFX_CHART chart;
+uint8_t chart_buf[2*CHART_WIDTH], chart_cnt;
+
+/* color key & alarm bar beside the image */
+#define BAR_X0 82
+#define BAR_X1 88
+
+/* watch mode wakes on any element changing by 1.5C between sensor frames */
+#define WATCH_DELTA (3*2)
+uint8_t watch_int[8];
+
+/* the sensor & its latest frame, filled in the background */
+AMG8833_DEV ir_sensor;
+uint16_t ir_array[64];
+uint8_t ir_reading, ir_rows, ir_piped;
+
+/* nav switch moves the spot instead of working the menu */
+uint8_t nav_mode;
+
+#ifdef TRACKER
+/* tracker crosshair centers as drawn, hot then cold, while trk_shown */
+GFX_POINT trk_mark[2];
+uint8_t trk_shown;
+#endif
+
+/* frozen on a frame from the history, optionally playing forward */
+uint8_t hist_held, hist_pos, hist_play;
+
+/* IR to color scale map - base has INTERP_FRAC fraction bits, gain is Q8 */
+enum map_modes
+{
+	MAP_MANUAL,
+	MAP_AUTO,
+	MAP_HEQ,
+};
+int16_t map_base;
+uint16_t map_gain;
+uint8_t map_mode;
+
 /*
  * convert Thermistor to int/frac in C or F
  */
@@ -78,34 +155,601 @@ void ir2if(uint16_t ir, uint8_t *c_int, uint8_t *c_frac, uint8_t f)
 }
 
 /*
- * convert byte to RGB color
+ * set up the IR to color scale map for the next frame
+ */
+void map_setup(int16_t *ir)
+{
+	map_mode = menu_item_vals[MNU_MAP];
+	if(map_mode == MAP_HEQ)
+	{
+		/* equalized from this frame */
+		heq_build(ir, ir_stats.min);
+	}
+	else if((map_mode == MAP_AUTO) && agc_valid)
+	{
+		/* automatic from recent frames */
+		agc_get_map(&map_base, &map_gain, INTERP_FRAC);
+	}
+	else
+	{
+		/* manual override from menu */
+		map_base = (110 - menu_item_vals[MNU_OFF])<<INTERP_FRAC;
+		map_gain = 256<<menu_item_vals[MNU_AMP];
+	}
+}
+
+/*
+ * convert IR value with INTERP_FRAC fraction bits to 0-255 color scale
  */
-GFX_COLOR color_map(uint8_t scale, uint8_t map)
+uint8_t ir2scale(int16_t ir)
 {
-	GFX_COLOR result;
+	if(map_mode == MAP_HEQ)
+		return heq_scale(ir, INTERP_FRAC);
 	
-	switch(map)
+	int32_t scale = ((int32_t)(ir - map_base) * map_gain) >> (8+INTERP_FRAC);
+	scale = scale < 0 ? 0 : scale;
+	scale = scale > 255 ? 255 : scale;
+	return scale;
+}
+
+/*
+ * prepare rows of the frame up to n as they arrive - repeats are checked on
+ * the raw values, then they're corrected, filtered and their stats gathered
+ */
+void ir_prep(uint8_t n)
+{
+	int16_t *ir = (int16_t *)ir_array;
+	uint8_t flt = menu_item_vals[MNU_FLT], i;
+	
+	for(;ir_rows<n;ir_rows++)
 	{
-		case 0: /* Red */
-			result = scale << 16;
-			break;
+		i = ir_rows*8;
+		sched_sum_add(&ir_array[i], 8);
+#ifdef STREAM
+		stream_row(ir_rows, &ir_array[i]);
+#endif
+#ifdef POWER
+		for(uint8_t j=i;j<i+8;j++)
+			power_update(j, ir[j]);
 		
-		case 1: /* Green */
-			result = scale << 8;
-			break;
+		// sensor is still settling
+		if(power_discard)
+			continue;
+#endif
+		
+#ifdef NUC
+		// offset & emissivity correction
+		for(uint8_t j=i;j<i+8;j++)
+			ir[j] = nuc_apply(j, ir[j]);
+#endif
+		
+		// temporal filter - last choice is the sensor's own averaging
+		if(flt && (flt < FLT_SENSOR))
+			filt_elems(ir, i, 8, flt);
+		else
+			filt_init();
+		
+		stats_elems(&ir_stats, ir, i, 8);
+		roi_rows(ir, ir_rows, 1);
+	}
+}
+
+/*
+ * wait until the first n rows of the frame have arrived & been prepared -
+ * returns FALSE if the read fails first
+ */
+uint8_t ir_wait(uint8_t n)
+{
+	while(ir_rows < n)
+	{
+		if(ir_sensor.xfer.status == I2C_ERROR)
+			return 0;
+		ir_prep(amg8833_array_rows(&ir_sensor));
+	}
+	return 1;
+}
+
+/*
+ * render 8x8 array as flat blocks
+ */
+void render_blocks(int16_t *ir)
+{
+	GFX_RECT rect;
+	uint16_t color;
+	int16_t v;
+	for(int y = 0;y<8;y++)
+	{
+		if(!ir_wait(y+1))
+			return;
+		for(int x = 0;x<8;x++)
+		{
+			rect.x0 = x*10;
+			rect.y0 = y*10;
+			rect.x1 = rect.x0+9;
+			rect.y1 = rect.y0+9;
+			v = ir[y*8+x];
+			if(iso_on && (v >= iso_raw))
+			{
+				color = iso_color;
+				iso_hit = 1;
+			}
+			else
+				color = pal_color(ir2scale(v<<INTERP_FRAC));
+			gfx_rawrect(&rect, color);
+		}
+	}
+}
+
+/*
+ * render 8x8 array upscaled to 80x80 one line at a time - palette indices
+ * overwrite the values in place (byte x never passes value x) and are
+ * expanded through the palette on the way out. Lines crossing the isotherm
+ * mark those pixels with ISO_IDX, taking the map's top color down a step,
+ * and are expanded in place from the right instead.
+ */
+void render_interp(int16_t *ir)
+{
+	const uint16_t *pal = pal_map;
+	uint8_t shift = pal_shift;
+	INTERP_STATE is;
+	int16_t line[INTERP_DST];
+	uint8_t *idx = (uint8_t *)line;
+	
+	if(!ir_wait(1))
+		return;
+	interp_start(&is, ir);
+	int16_t v;
+	uint8_t hit;
+	for(int y = 0;y<INTERP_DST;y++)
+	{
+		if(!ir_wait(interp_src_rows(y)))
+			return;
+		interp_row(&is, line);
+		hit = 0;
+		for(int x = 0;x<INTERP_DST;x++)
+		{
+			v = line[x];
+			idx[x] = ir2scale(v) >> shift;
+			if(iso_on)
+			{
+				if(v >= iso_lin)
+				{
+					idx[x] = ISO_IDX;
+					hit = 1;
+				}
+				else if(idx[x] == ISO_IDX)
+					idx[x]--;
+			}
+		}
+		
+		if(!hit)
+			gfx_bitblt_idx(0, y, INTERP_DST, 1, idx, 8, pal);
+		else
+		{
+			for(int x = INTERP_DST-1;x>=0;x--)
+				line[x] = idx[x] == ISO_IDX ? iso_color : pal[idx[x]];
+			gfx_bitblt(0, y, INTERP_DST, 1, (uint16_t *)line);
+			iso_hit = 1;
+		}
+	}
+}
+
+/*
+ * color key between the image & the readouts, hottest at the top - the
+ * colors are built coldest first and the display turns them up the screen
+ */
+void pal_bar(void)
+{
+	uint16_t bar[80];
+	int16_t i;
+	
+	for(i=0;i<80;i++)
+		bar[i] = pal_color((i*413)>>7);
+	for(i=BAR_X0;i<=BAR_X1;i++)
+		gfx_bitblt_orient(i, 0, 80, 1, bar, GFX_ORIENT_ROT270);
+}
+
+#ifdef ISO
+/*
+ * show the alarm over the color key when the alarm changes
+ */
+void iso_alarm_bar(void)
+{
+	GFX_RECT rect = {BAR_X0, 0, BAR_X1, 79};
+	uint8_t alarm = iso_hit && menu_item_vals[MNU_ALM];
+	
+	if(alarm == iso_alarm)
+		return;
+	iso_alarm = alarm;
+	
+	if(alarm)
+	{
+		printf("alarm: over %dC\n\r", iso_temps[menu_item_vals[MNU_ISO]]);
+		gfx_set_forecolor(GFX_RED);
+		gfx_fillrect(&rect);
+	}
+	else
+		pal_bar();
+}
+#endif
+
+/*
+ * outline the spot, highlighted while the nav switch moves it
+ */
+void roi_outline(void)
+{
+	GFX_RECT rect;
+	
+	rect.x0 = roi_x*10;
+	rect.y0 = roi_y*10;
+	rect.x1 = rect.x0+roi_size*10-1;
+	rect.y1 = rect.y0+roi_size*10-1;
+	gfx_set_forecolor(nav_mode ? GFX_YELLOW : GFX_WHITE);
+	gfx_drawrect(&rect);
+}
+
+/*
+ * erase the spot outline by repainting its edges in the colors of the
+ * elements below - exact for blocks, close enough for interpolation until
+ * the next frame
+ */
+void roi_erase(void)
+{
+	int16_t *ir = (int16_t *)ir_array;
+	uint8_t e = roi_size-1, i;
+	GFX_RECT rect;
+	
+	for(i=0;i<roi_size;i++)
+	{
+		/* top & bottom */
+		rect.x0 = (roi_x+i)*10;
+		rect.x1 = rect.x0+9;
+		rect.y0 = rect.y1 = roi_y*10;
+		gfx_rawrect(&rect, pal_color(ir2scale(ir[roi_y*8+roi_x+i]<<INTERP_FRAC)));
+		rect.y0 = rect.y1 = (roi_y+roi_size)*10-1;
+		gfx_rawrect(&rect, pal_color(ir2scale(ir[(roi_y+e)*8+roi_x+i]<<INTERP_FRAC)));
+		
+		/* left & right */
+		rect.y0 = (roi_y+i)*10;
+		rect.y1 = rect.y0+9;
+		rect.x0 = rect.x1 = roi_x*10;
+		gfx_rawrect(&rect, pal_color(ir2scale(ir[(roi_y+i)*8+roi_x]<<INTERP_FRAC)));
+		rect.x0 = rect.x1 = (roi_x+roi_size)*10-1;
+		gfx_rawrect(&rect, pal_color(ir2scale(ir[(roi_y+i)*8+roi_x+e]<<INTERP_FRAC)));
+	}
+}
+
+/*
+ * map & render the frame in ir_array, waiting for rows as they're needed
+ */
+void render_frame(void)
+{
+#ifdef BENCH
+	uint32_t bench = SysTick->CNT;
+#endif
+	map_setup((int16_t *)ir_array);
+	iso_hit = 0;
+	if(menu_item_vals[MNU_INT])
+		render_interp((int16_t *)ir_array);
+	else
+		render_blocks((int16_t *)ir_array);
+	
+	/* read failed part way - the rest of the last frame stays up */
+	if(ir_sensor.xfer.status == I2C_ERROR)
+		return;
+#ifdef BENCH
+	bench = SysTick->CNT - bench;
+	printf("render: %u clocks%s, late %u max %u ms, dup %u miss %u\n\r",
+		(unsigned)bench, ir_piped ? " piped" : "", sched_late, sched_late_max,
+		(unsigned)sched_dups, (unsigned)sched_misses);
+	
+	/* cost of the fused stats pass on its own, run again over this frame */
+	FSTATS bench_stats;
+	bench = SysTick->CNT;
+	stats_frame(&bench_stats, (int16_t *)ir_array);
+	bench = SysTick->CNT - bench;
+	printf("stats: %u clocks\n\r", (unsigned)bench);
+#endif
+	
+#ifdef TRACKER
+	// the whole image is new, markers & all
+	trk_shown = 0;
+#endif
+	
+	// outline the spot
+	roi_outline();
+	
+#ifdef ISO
+	// alarm over the color key
+	iso_alarm_bar();
+#endif
+	
+#ifdef WATCH
+	// mark elements that woke watch mode
+	if(menu_item_vals[MNU_WCH])
+	{
+		GFX_RECT rect;
+		gfx_set_forecolor(GFX_RED);
+		for(int y = 0;y<8;y++)
+			for(int x = 0;x<8;x++)
+				if(watch_int[y] & (1<<x))
+				{
+					rect.x0 = x*10;
+					rect.y0 = y*10;
+					rect.x1 = rect.x0+9;
+					rect.y1 = rect.y0+9;
+					gfx_drawrect(&rect);
+				}
+	}
+#endif
+}
+
+#ifdef TRACKER
+/*
+ * ends of a crosshair arm centered on c, clipped to the image
+ */
+void trk_arm(int16_t c, int16_t *c0, int16_t *c1)
+{
+	*c0 = c < 3 ? 0 : c-3;
+	*c1 = c > 76 ? 79 : c+3;
+}
+
+/*
+ * draw a crosshair at a tracked spot & note where it went
+ */
+void trk_marker(TRK_SPOT *spot, GFX_POINT *mark)
+{
+	int16_t x0, x1, y0, y1;
+	
+	mark->x = ((spot->x * 10) >> TRK_FRAC) + 5;
+	mark->y = ((spot->y * 10) >> TRK_FRAC) + 5;
+	trk_arm(mark->x, &x0, &x1);
+	trk_arm(mark->y, &y0, &y1);
+	gfx_drawhline(mark->y, x0, x1);
+	gfx_drawvline(mark->x, y0, y1);
+}
+
+/*
+ * erase the crosshairs still up by repainting them a piece per element in
+ * the colors of the elements below, like the spot outline
+ */
+void trk_erase(void)
+{
+	int16_t *ir = (int16_t *)ir_array;
+	int16_t c0, c1, e;
+	GFX_RECT rect;
+	uint8_t i;
+	
+	if(!trk_shown)
+		return;
+	trk_shown = 0;
+	
+	for(i=0;i<2;i++)
+	{
+		/* across */
+		trk_arm(trk_mark[i].x, &c0, &c1);
+		rect.y0 = rect.y1 = trk_mark[i].y;
+		for(rect.x0=c0;rect.x0<=c1;rect.x0=rect.x1+1)
+		{
+			e = rect.x0/10;
+			rect.x1 = e*10+9 < c1 ? e*10+9 : c1;
+			gfx_rawrect(&rect, pal_color(ir2scale(ir[(rect.y0/10)*8+e]<<INTERP_FRAC)));
+		}
 		
-		case 2: /* Blue */
-			result = scale;
+		/* down */
+		trk_arm(trk_mark[i].y, &c0, &c1);
+		rect.x0 = rect.x1 = trk_mark[i].x;
+		for(rect.y0=c0;rect.y0<=c1;rect.y0=rect.y1+1)
+		{
+			e = rect.y0/10;
+			rect.y1 = e*10+9 < c1 ? e*10+9 : c1;
+			gfx_rawrect(&rect, pal_color(ir2scale(ir[e*8+rect.x0/10]<<INTERP_FRAC)));
+		}
+	}
+	
+	/* the spot outline may have been crossed */
+	roi_outline();
+}
+#endif
+
+/*
+ * readout of a raw IR value on a text row in a color
+ */
+void ir_readout(int16_t y, int16_t ir, GFX_COLOR color)
+{
+	uint8_t ci, cf;
+	
+	ir2if(ir, &ci, &cf, menu_item_vals[MNU_DEG]);
+	sprintf(textbuf, "%3d.%02d", ci, cf);
+	gfx_set_forecolor(color);
+	gfx_drawstr(MNU_XSTART, y, textbuf);
+}
+
+/*
+ * readout of the spot mean, with its range in whole degrees below when
+ * it covers more than one element - the tracker has those rows when on
+ * and the presence counts take the lower one
+ */
+void roi_readout(void)
+{
+	uint8_t ci, cf;
+	
+	if(menu_item_vals[MNU_TRK])
+		return;
+	
+	ir_readout(MNU_YSPACE, roi_mean, GFX_WHITE);
+	if((roi_size > 1) && !menu_item_vals[MNU_PRS])
+	{
+		ir2if(roi_min, &ci, &cf, menu_item_vals[MNU_DEG]);
+		sprintf(textbuf, "%3d", ci);
+		gfx_set_forecolor(GFX_LBLUE);
+		gfx_drawstr(MNU_XSTART, 2*MNU_YSPACE, textbuf);
+		ir2if(roi_max, &ci, &cf, menu_item_vals[MNU_DEG]);
+		sprintf(textbuf, "%3d", ci);
+		gfx_set_forecolor(GFX_RED);
+		gfx_drawstr(MNU_XSTART+32, 2*MNU_YSPACE, textbuf);
+	}
+}
+
+/*
+ * move or resize the spot between frames - only its outline & readout
+ * are redrawn
+ */
+void roi_move(int8_t x, int8_t y, uint8_t size)
+{
+	GFX_RECT rect = {MNU_XSTART, 2*MNU_YSPACE, 159, 2*MNU_YSPACE+7};
+	
+	roi_erase();
+	if(size != roi_size)
+		gfx_clrrect(&rect);
+	roi_set(x, y, size);
+	roi_outline();
+	roi_frame((int16_t *)ir_array);
+	roi_readout();
+}
+
+#ifdef NUC
+/*
+ * count a read towards an offset capture & report when it's saved
+ */
+void nuc_finish(void)
+{
+	switch(nuc_frame_done(menu_item_vals[MNU_EMS]))
+	{
+		case 1:
+			printf("offsets saved\n\r");
+			menu_item_vals[MNU_NUC] = 1;
+			menu_render(1<<MNU_NUC);
 			break;
 		
-		case 3: /* White */
-		default:
-			result = (scale << 16) | (scale << 8) | scale ;\
+		case 2:
+			printf("offset save failed\n\r");
+			menu_item_vals[MNU_NUC] = 0;
+			menu_render(1<<MNU_NUC);
 			break;
 	}
-	return result;
+}
+#endif
+
+#ifdef PRESENCE
+/*
+ * run the presence detector, showing blobs, the line & the counts of
+ * blobs, entries & exits, which also go to the debug port when they change
+ */
+void pres_readout(void)
+{
+	int16_t x, y;
+	uint8_t i;
+	
+	if(pres_frame((int16_t *)ir_array))
+		printf("presence: %d in %u out %u\n\r", pres_num, pres_in, pres_out);
+	
+	gfx_set_forecolor(GFX_CYAN);
+	gfx_drawvline(((PRES_LINE*10) >> PRES_FRAC) + 5, 0, 79);
+	gfx_set_forecolor(GFX_GREEN);
+	for(i=0;i<pres_num;i++)
+	{
+		x = ((pres_blobs[i].x * 10) >> PRES_FRAC) + 5;
+		y = ((pres_blobs[i].y * 10) >> PRES_FRAC) + 5;
+		gfx_drawcircle(x, y, 3);
+	}
+	
+	sprintf(textbuf, "%d", pres_num);
+	gfx_set_forecolor(GFX_WHITE);
+	gfx_drawstr(MNU_XSTART, 2*MNU_YSPACE, textbuf);
+	sprintf(textbuf, "%3u", pres_in);
+	gfx_set_forecolor(GFX_GREEN);
+	gfx_drawstr(MNU_XSTART+16, 2*MNU_YSPACE, textbuf);
+	sprintf(textbuf, "%3u", pres_out);
+	gfx_set_forecolor(GFX_RED);
+	gfx_drawstr(MNU_XSTART+40, 2*MNU_YSPACE, textbuf);
+}
+#endif
+
+/*
+ * readouts & chart for a new frame in ir_array
+ */
+void process_frame(void)
+{
+	// readout built-in thermistor
+	uint16_t temp, tf;
+	uint8_t ti;
+	amg8833_get_thermistor(&ir_sensor, &temp);
+#ifdef NUC
+	nuc_set_amb(temp);
+#endif
+#ifdef STREAM
+	if(menu_item_vals[MNU_STR])
+		stream_finish(temp);
+#endif
+	therm2if(temp, &ti, &tf, menu_item_vals[MNU_DEG]);
+	//printf("Thermistor: %d.%04d\n\r", ti, tf);
+	sprintf(textbuf, "%d.%04d", ti, tf);
+	gfx_set_forecolor(GFX_WHITE);
+	gfx_drawstr(MNU_XSTART, 0, textbuf);
+	
+	// readout spot, or hot & cold spots marked over the image
+#ifdef TRACKER
+	trk_erase();
+	if(menu_item_vals[MNU_TRK])
+	{
+		trk_frame((int16_t *)ir_array, &ir_stats);
+		ir_readout(MNU_YSPACE, trk_hot.val, GFX_RED);
+		if(!menu_item_vals[MNU_PRS])
+			ir_readout(2*MNU_YSPACE, trk_cold.val, GFX_LBLUE);
+		gfx_set_forecolor(GFX_RED);
+		trk_marker(&trk_hot, &trk_mark[0]);
+		gfx_set_forecolor(GFX_LBLUE);
+		trk_marker(&trk_cold, &trk_mark[1]);
+		trk_shown = 1;
+	}
+	else
+#endif
+		roi_readout();
+	
+#ifdef PRESENCE
+	// presence counts below, blobs & counting line over the image - it
+	// waits while an offset capture has its background
+	if(menu_item_vals[MNU_PRS] && !nuc_capture)
+		pres_readout();
+#endif
+	
+	// plot thermistor & center element
+	if(++chart_cnt >= CHART_DECIM)
+	{
+		int16_t vals[2];
+		vals[0] = temp>>2;
+		vals[1] = roi_mean;
+		gfx_chart_add(&chart, vals);
+		chart_cnt = 0;
+	}
 }
 
+#ifdef HISTORY
+/*
+ * show frame hist_pos of the history with its age in frames on the top row
+ */
+void hist_show(void)
+{
+	int16_t *ir = (int16_t *)ir_array;
+	
+	if(!hist_frames)
+		return;
+	
+	hist_frame(hist_pos, ir);
+	stats_frame(&ir_stats, ir);
+	roi_frame(ir);
+	ir_rows = 8;
+	ir_piped = 0;
+	render_frame();
+	roi_readout();
+	
+	sprintf(textbuf, "his -%-3d", hist_frames-1-hist_pos);
+	gfx_set_forecolor(GFX_YELLOW);
+	gfx_drawstr(MNU_XSTART, 0, textbuf);
+}
+#endif
+
 /*
  * Start here
  */
@@ -135,7 +779,7 @@ int main()
 	gfx_set_forecolor(GFX_WHITE);
 	gfx_drawstrctr(80, 40-4, "Initializing Sensor");
 	Delay_Ms(100);
-	if(amg8833_init())
+	if(amg8833_init(&ir_sensor, AMG8833_I2C_ADDR_HI))
 	{
 		gfx_set_forecolor(GFX_RED);
 		gfx_drawstrctr(80, 40-4, "  IR Sensor failed  ");
@@ -149,57 +793,305 @@ int main()
 
 	/* start menu */
 	menu_init();
+	pal_select(menu_item_vals[MNU_CLR]);
+	agc_init();
+	filt_init();
 	printf("initialized menu\n\r");
+	
+	/* start chart below menu */
+	GFX_RECT rect = {MNU_XSTART-1, 61, 159, 79};
+	gfx_chart_init(&chart, &rect, CHART_TMIN, CHART_TMAX, 2, chart_buf);
+	gfx_chart_color(&chart, 0, GFX_LBLUE);
+	gfx_chart_color(&chart, 1, GFX_YELLOW);
+	chart_cnt = 0;
+
+	/* pace reads from the sensor frame rate */
+	sched_init(POWER_FULL_PERIOD);
+#ifdef POWER
+	power_init(&ir_sensor);
+#endif
+	roi_init();
+	nav_mode = 0;
+#ifdef NUC
+	menu_item_vals[MNU_EMS] = nuc_init();
+	menu_item_vals[MNU_NUC] = nuc_on;
+	uint16_t therm;
+	if(!amg8833_get_thermistor(&ir_sensor, &therm))
+		nuc_set_amb(therm);
+#endif
+	printf("initialized scheduler\n\r");
+	
+#ifdef HISTORY
+	/* history takes what's left of SRAM */
+	hist_init();
+	printf("history ring %u bytes\n\r", hist_size);
+#endif
+	hist_held = hist_play = 0;
+#ifdef STREAM
+	stream_init();
+#endif
+#ifdef ISO
+	iso_init();
+#endif
+	pal_bar();
 
 	printf("Looping...\n\r");
+	ir_reading = 0;
+	uint32_t sensor_pending = 0;
 	while(1)
 	{
-		// readout built-in thermistor
-		uint16_t temp, tf;
-		uint8_t ti;
-		amg8833_get_thermistor(&temp);
-		therm2if(temp, &ti, &tf, menu_item_vals[0]);
-		//printf("Thermistor: %d.%04d\n\r", ti, tf);
-		sprintf(textbuf, "%d.%04d", ti, tf);
-		gfx_set_forecolor(GFX_WHITE);
-		gfx_drawstr(MNU_XSTART, 0, textbuf);
-		
-		// get array
-		uint16_t ir_array[64];
-		uint8_t ci, cf;
-		amg8833_get_array(ir_array);
-		
-		// readout center element
-		ir2if(ir_array[3*8+3], &ci, &cf, menu_item_vals[0]);
-		sprintf(textbuf, "%3d.%02d", ci, cf);
-		gfx_drawstr(MNU_XSTART, MNU_YSPACE, textbuf);
-		
-		// render 8x8 array grid
-		GFX_RECT rect;
-		for(int y = 0;y<8;y++)
+#ifdef POWER
+		/* buttons hold off or end the slow down, the one that wakes the sensor is eaten */
+		if(SysTick_any_button() && power_wake())
 		{
-			/* render graphics */
-			for(int x = 0;x<8;x++)
+			SysTick_clr_buttons();
+			filt_init();
+			sensor_pending |= (1<<MNU_FLT) | (1<<MNU_WCH);
+		}
+		
+		/* nothing to do while asleep */
+		if(power_state == PWR_SLEEP)
+		{
+			__WFI();
+			continue;
+		}
+#endif
+		
+		/* start reading when the next sensor frame is due */
+		if(!ir_reading && !menu_item_vals[MNU_HIS] && sched_due())
+		{
+#ifdef WATCH
+			/* in watch mode only check for changes until something fires */
+			if(menu_item_vals[MNU_WCH] &&
+				!amg8833_watch_check(&ir_sensor, watch_int))
+				sched_skip();
+			else
+#endif
+			if(!amg8833_get_array_start(&ir_sensor, ir_array))
 			{
-				int16_t scale = ((int16_t)ir_array[y*8+x]-110 + menu_item_vals[2])<<menu_item_vals[3];
-				scale = scale < 0 ? 0 : scale;
-				scale = scale > 255 ? 255 : scale;
-				rect.x0 = x*10;
-				rect.y0 = y*10;
-				rect.x1 = rect.x0+9;
-				rect.y1 = rect.y0+9;
-				gfx_colorrect(&rect, color_map(scale, menu_item_vals[1]));
+				ir_reading = 1;
+				ir_rows = 0;
+				sched_sum_start();
+				stats_start(&ir_stats);
+				roi_start();
+#ifdef STREAM
+				if(menu_item_vals[MNU_STR])
+					stream_start();
+#endif
 				
-				// draw a box around center rect
-				if((x==3)&&(y==3))
-					gfx_drawrect(&rect);
-
+				/* render rows as they arrive unless the map needs them all */
+				ir_piped = !power_discard && (menu_item_vals[MNU_MAP] != MAP_HEQ);
+				if(ir_piped)
+					render_frame();
 			}
 		}
 		
-		/* handle menu */
-		menu_proc();
+		/* finish up when it has arrived */
+		if(ir_reading && !amg8833_xfer_pending(&ir_sensor))
+		{
+			ir_reading = 0;
+			if(ir_sensor.xfer.status == I2C_ERROR)
+			{
+				printf("array read error %04x\n\r", ir_sensor.xfer.err);
+				i2c_fault();
+				
+#ifdef NUC
+				/* rows that did arrive were gathered, start again */
+				if(nuc_capture)
+					nuc_start();
+#endif
+			}
+			else
+			{
+				ir_prep(8);
+				stats_done(&ir_stats);
+				roi_done();
+				
+#ifdef NUC
+				/* every read of a capture counts, duplicates or not */
+				if(!power_discard)
+					nuc_finish();
+#endif
+				if(sched_frame_done())
+				{
+					if(power_discard)
+						power_discard--;
+					else
+					{
+						if(!ir_piped)
+							render_frame();
+						
+						/* only new live frames steer the ranging & the filter */
+						agc_frame_done(ir_stats.min, ir_stats.max);
+						filt_frame_done((int16_t *)ir_array);
+						process_frame();
+#ifdef POWER
+						power_frame_done(menu_item_vals[MNU_PWR]);
+#endif
+#ifdef HISTORY
+						hist_add((int16_t *)ir_array);
+#endif
+					}
+				}
+			}
+		}
+		
+#ifdef STREAM
+		/* feed the debugger the next piece of a streamed frame */
+		stream_poll();
+#endif
+		
+		/* show fallback to standard mode */
+		if(menu_item_vals[MNU_I2C] && (i2c_rate == I2C_CLKRATE))
+		{
+			menu_item_vals[MNU_I2C] = 0;
+			menu_render(1<<MNU_I2C);
+		}
+		
+		/* center switches the nav between menu & spot */
+		uint32_t changed = 0;
+		if(SysTick_get_button(BTN_CTR))
+		{
+			nav_mode = !nav_mode;
+			roi_outline();
+		}
+		if(!nav_mode)
+			changed = menu_proc();
+#ifdef HISTORY
+		else if(hist_held)
+		{
+			/* step through the history, go to the oldest or play forward */
+			uint8_t pos = hist_pos;
+			if(SysTick_get_button(BTN_LEFT) && hist_pos)
+				hist_pos--;
+			else if(SysTick_get_button(BTN_RIGHT) && (hist_pos+1 < hist_frames))
+				hist_pos++;
+			else if(SysTick_get_button(BTN_DOWN))
+				hist_pos = 0;
+			else if(SysTick_get_button(BTN_UP))
+			{
+				hist_play = 1;
+				sched_resync(sched_period);
+			}
+			if(hist_pos != pos)
+			{
+				hist_play = 0;
+				hist_show();
+			}
+		}
+#endif
+		else if(!ir_reading)
+		{
+			if(SysTick_get_button(BTN_UP))
+				roi_move(roi_x, roi_y-1, roi_size);
+			else if(SysTick_get_button(BTN_DOWN))
+				roi_move(roi_x, roi_y+1, roi_size);
+			else if(SysTick_get_button(BTN_LEFT))
+				roi_move(roi_x-1, roi_y, roi_size);
+			else if(SysTick_get_button(BTN_RIGHT))
+				roi_move(roi_x+1, roi_y, roi_size);
+		}
+		
+		/* resize waits for the array to be idle, like the moves */
+		if(!ir_reading && (roi_size != menu_item_vals[MNU_ROI]+1))
+			roi_move(roi_x, roi_y, menu_item_vals[MNU_ROI]+1);
+		
+#ifdef HISTORY
+		/* freeze once the bus is idle & go live again from the next read */
+		if(menu_item_vals[MNU_HIS] && !hist_held && !ir_reading)
+		{
+			hist_held = 1;
+			hist_play = 0;
+			hist_pos = hist_frames ? hist_frames-1 : 0;
+			hist_show();
+		}
+		else if(!menu_item_vals[MNU_HIS] && hist_held)
+		{
+			GFX_RECT rect = {MNU_XSTART, 0, 159, 7};
+			gfx_clrrect(&rect);
+			hist_held = 0;
+			sched_resync(sched_period);
+		}
+		else if(hist_play && sched_due())
+		{
+			/* replay at the sensor rate up to the newest frame */
+			sched_skip();
+			if(hist_pos+1 < hist_frames)
+			{
+				hist_pos++;
+				hist_show();
+			}
+			else
+				hist_play = 0;
+		}
+		else if(hist_held && changed)
+			hist_show();
+#endif
+		
+#ifdef NUC
+		/* offset capture starts from the menu & ends by itself */
+		if(changed & (1<<MNU_NUC))
+		{
+			nuc_on = (menu_item_vals[MNU_NUC] == 1) && nuc_valid();
+			nuc_capture = 0;
+			if(menu_item_vals[MNU_NUC] == 2)
+			{
+				nuc_start();
+				pres_learn = PRES_LEARN;
+			}
+			filt_init();
+		}
+		if(changed & (1<<MNU_EMS))
+			nuc_set_ems(menu_item_vals[MNU_EMS]);
+#endif
+#ifdef ISO
+		if(changed & (1<<MNU_ISO))
+			iso_set(menu_item_vals[MNU_ISO]);
+#endif
+		if(changed & (1<<MNU_CLR))
+		{
+			pal_select(menu_item_vals[MNU_CLR]);
+			if(!iso_alarm)
+				pal_bar();
+		}
+		
+#ifdef PRESENCE
+		/* presence learns a fresh background each time it's turned on */
+		if(changed & (1<<MNU_PRS))
+			pres_init();
+#endif
+		
+		/* sensor settings wait for the bus */
+		sensor_pending |= changed & ((1<<MNU_FLT) | (1<<MNU_I2C) | (1<<MNU_WCH));
+		
+#ifdef TRACKER
+		if(changed & (1<<MNU_TRK))
+			trk_erase();
+#endif
+		
+		/* lower readout row changes hands with the tracker & presence */
+		if(changed & ((1<<MNU_TRK) | (1<<MNU_PRS)))
+		{
+			GFX_RECT rect = {MNU_XSTART, 2*MNU_YSPACE, 159, 2*MNU_YSPACE+7};
+			gfx_clrrect(&rect);
+		}
+		if(sensor_pending && !ir_reading)
+		{
+			if(sensor_pending & (1<<MNU_I2C))
+				i2c_speed(menu_item_vals[MNU_I2C] ?
+					I2C_FASTRATE : I2C_CLKRATE);
+			if(sensor_pending & (1<<MNU_FLT))
+				amg8833_set_avg(&ir_sensor,
+					menu_item_vals[MNU_FLT] == FLT_SENSOR);
+#ifdef WATCH
+			if(sensor_pending & (1<<MNU_WCH))
+				amg8833_watch(&ir_sensor, menu_item_vals[MNU_WCH],
+					WATCH_DELTA);
+#endif
+			sensor_pending = 0;
+		}
 		
-		Delay_Ms(100);
+		/* sleep until next tick */
+		__WFI();
 	}
 }
@@ -0,0 +1,206 @@
+/*
+ * nuc.h - single-file header for non-uniformity & emissivity correction
+ * 10-19-26 E. Brombaugh
+ *
+ * The offset of each element from the frame mean is captured by averaging
+ * NUC_FRAMES frames of a uniform target - a lens cap or a blank wall - and
+ * kept as 64 signed bytes in raw units at the top of flash, along with the
+ * emissivity choice, so it survives reset. Emissivity is corrected to first
+ * order: the element sees the target plus the rest of the room at ambient,
+ * with radiance taken as linear in temperature over the scope's range, so
+ * the reading is scaled away from the thermistor by a Q8 1/e.
+ */
+
+#ifndef __nuc__
+#define __nuc__
+
+#define NUC_SHIFT 4					// log2 of frames averaged in a capture
+#define NUC_FRAMES (1<<NUC_SHIFT)
+#define NUC_MAGIC 0x4e554331		// "NUC1"
+
+/*
+ * last two 64-byte pages of the 16kB flash - nl_irscope.ld keeps the image
+ * below
+ */
+#define NUC_ADDR 0x08003f80
+#define NUC_PAGE 64
+
+typedef struct
+{
+	uint32_t magic;
+	uint8_t ems;					// emissivity choice
+	uint8_t rsvd[3];
+	int8_t offs[64];				// raw units subtracted from each element
+} NUC_STORE;
+
+#define nuc_store ((const NUC_STORE *)NUC_ADDR)
+
+/* 1/e in Q8 for the emissivity choices */
+const uint16_t nuc_gains[] =
+{
+	256, 269, 284, 301, 320, 366, 427, 512
+};
+
+uint8_t nuc_on, nuc_capture;
+uint16_t nuc_gain;
+int16_t nuc_amb;
+int16_t nuc_acc[64];
+
+/*
+ * erase & program one page from words in RAM, padding with erased words
+ */
+void nuc_page(uint32_t addr, const uint32_t *src, uint8_t words)
+{
+	volatile uint32_t *dst = (volatile uint32_t *)addr;
+	uint8_t i;
+
+	FLASH->CTLR = CR_PAGE_ER;
+	FLASH->ADDR = addr;
+	FLASH->CTLR = CR_STRT_Set | CR_PAGE_ER;
+	while(FLASH->STATR & FLASH_STATR_BSY);
+
+	/* page buffer is filled a word at a time then written in one go */
+	FLASH->CTLR = CR_PAGE_PG;
+	FLASH->CTLR = CR_BUF_RST | CR_PAGE_PG;
+	FLASH->ADDR = addr;
+	while(FLASH->STATR & FLASH_STATR_BSY);
+	for(i=0;i<NUC_PAGE/4;i++)
+	{
+		dst[i] = i < words ? src[i] : 0xffffffff;
+		FLASH->CTLR = CR_PAGE_PG | CR_BUF_LOAD;
+		while(FLASH->STATR & FLASH_STATR_BSY);
+	}
+	FLASH->CTLR = CR_PAGE_PG | CR_STRT_Set;
+	while(FLASH->STATR & FLASH_STATR_BSY);
+	FLASH->CTLR = 0;
+}
+
+/*
+ * write a table & emissivity to flash - returns 1 if it doesn't read back
+ */
+uint8_t nuc_save(NUC_STORE *s)
+{
+	const uint32_t *src = (const uint32_t *)s;
+	uint8_t words = sizeof(NUC_STORE)/4, i;
+
+	s->magic = NUC_MAGIC;
+	s->rsvd[0] = s->rsvd[1] = s->rsvd[2] = 0xff;
+
+	FLASH->KEYR = FLASH_KEY1;
+	FLASH->KEYR = FLASH_KEY2;
+	FLASH->MODEKEYR = FLASH_KEY1;
+	FLASH->MODEKEYR = FLASH_KEY2;
+
+	for(i=0;i<sizeof(NUC_STORE);i+=NUC_PAGE)
+		nuc_page(NUC_ADDR+i, &src[i/4], words-i/4);
+
+	FLASH->CTLR = CR_LOCK_Set;
+
+	return memcmp(s, nuc_store, sizeof(NUC_STORE)) ? 1 : 0;
+}
+
+/*
+ * is there a table in flash
+ */
+uint8_t nuc_valid(void)
+{
+	return nuc_store->magic == NUC_MAGIC;
+}
+
+/*
+ * set the emissivity choice
+ */
+void nuc_set_ems(uint8_t ems)
+{
+	nuc_gain = nuc_gains[ems];
+}
+
+/*
+ * set ambient from a raw sign-magnitude thermistor reading
+ */
+void nuc_set_amb(uint16_t therm)
+{
+	nuc_amb = (therm & 0x7ff) >> 2;
+	if(therm & 0x800)
+		nuc_amb = -nuc_amb;
+}
+
+/*
+ * start from the stored table if there is one - returns emissivity choice
+ */
+uint8_t nuc_init(void)
+{
+	uint8_t ems = 0;
+
+	nuc_on = nuc_valid();
+	nuc_capture = 0;
+	if(nuc_on && (nuc_store->ems < sizeof(nuc_gains)/sizeof(uint16_t)))
+		ems = nuc_store->ems;
+	nuc_set_ems(ems);
+	nuc_amb = 0;
+
+	return ems;
+}
+
+/*
+ * start averaging frames of a uniform target
+ */
+void nuc_start(void)
+{
+	memset(nuc_acc, 0, sizeof(nuc_acc));
+	nuc_capture = NUC_FRAMES;
+}
+
+/*
+ * correct raw element i as it's prepared, gathering it first if capturing
+ */
+static inline int16_t nuc_apply(uint8_t i, int16_t ir)
+{
+	if(nuc_capture)
+		nuc_acc[i] += ir;
+
+	if(nuc_on)
+		ir -= nuc_store->offs[i];
+
+	if(nuc_gain != 256)
+		ir = nuc_amb + (((int32_t)(ir - nuc_amb) * nuc_gain) >> 8);
+
+	return ir;
+}
+
+/*
+ * count a finished frame - when a capture completes the offsets from the
+ * mean are saved with the emissivity choice. returns 1 when a capture is
+ * saved, 2 if it failed to save & 0 otherwise.
+ */
+uint8_t nuc_frame_done(uint8_t ems)
+{
+	NUC_STORE s;
+	int32_t sum = 0;
+	int16_t off;
+	uint8_t i;
+
+	if(!nuc_capture || --nuc_capture)
+		return 0;
+
+	for(i=0;i<64;i++)
+		sum += nuc_acc[i];
+	sum >>= 6;
+
+	/* rounded average offset, clamped to a byte */
+	for(i=0;i<64;i++)
+	{
+		off = (nuc_acc[i] - sum + NUC_FRAMES/2) >> NUC_SHIFT;
+		off = off > 127 ? 127 : off;
+		off = off < -127 ? -127 : off;
+		s.offs[i] = off;
+	}
+
+	s.ems = ems;
+	if(nuc_save(&s))
+		return 2;
+	nuc_on = 1;
+	return 1;
+}
+
+#endif
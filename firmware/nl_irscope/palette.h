@@ -0,0 +1,144 @@
+/*
+ * palette.h - single-file header for 256-step color maps
+ * 10-19-26 E. Brombaugh
+ *
+ * Entries are 565 color in native (byte swapped) order for the ST7735 so
+ * they can be sent or passed to the indexed bitblt without conversion. The
+ * single color & gray ramps only have 64 distinct steps, so rather than
+ * sitting in flash the one in use is built in SRAM when it's chosen and
+ * looked up with the color scale shifted down to match.
+ */
+
+#ifndef __palette__
+#define __palette__
+
+enum palettes
+{
+	PAL_RED,
+	PAL_GREEN,
+	PAL_BLUE,
+	PAL_GRAY,
+	PAL_IRON,
+	PAL_RAINBOW,
+	PAL_NUM
+};
+
+/* ironbow - black, violet, red, orange, yellow, white */
+const uint16_t pal_iron[256] =
+{
+	0x0000, 0x0000, 0x0000, 0x0100, 0x0100, 0x0200, 0x0200, 0x0200,
+	0x0308, 0x0308, 0x0308, 0x0408, 0x0408, 0x0508, 0x0508, 0x0510,
+	0x0610, 0x0610, 0x0710, 0x0710, 0x0710, 0x0810, 0x0810, 0x0918,
+	0x0918, 0x0918, 0x0A18, 0x0A18, 0x0B18, 0x0B18, 0x0B18, 0x0C20,
+	0x0C20, 0x0D20, 0x0D20, 0x0D20, 0x0E20, 0x0E20, 0x0E28, 0x0F28,
+	0x0F28, 0x0F28, 0x0F30, 0x0F30, 0x0F30, 0x0F30, 0x0F38, 0x0F38,
+	0x0F38, 0x0F38, 0x0F40, 0x1040, 0x1040, 0x1048, 0x1048, 0x1048,
+	0x1048, 0x1050, 0x1050, 0x1050, 0x1050, 0x1058, 0x1058, 0x1058,
+	0x1060, 0x1160, 0x1160, 0x1160, 0x1168, 0x1168, 0x1168, 0x1168,
+	0x1170, 0x1170, 0x1170, 0x1170, 0x1178, 0x1178, 0x1178, 0x1280,
+	0x1280, 0x1280, 0x1280, 0x1288, 0x1288, 0x1288, 0x1288, 0x1290,
+	0x1290, 0x1290, 0x1290, 0x1298, 0x1298, 0x3198, 0x3198, 0x3198,
+	0x50A0, 0x50A0, 0x50A0, 0x50A0, 0x6FA0, 0x6FA8, 0x6FA8, 0x8FA8,
+	0x8EA8, 0x8EA8, 0xAEB0, 0xAEB0, 0xADB0, 0xADB0, 0xCDB0, 0xCCB8,
+	0xCCB8, 0xECB8, 0xECB8, 0xEBB8, 0xEBC0, 0x0BC1, 0x0BC1, 0x0AC1,
+	0x2AC1, 0x2AC9, 0x29C9, 0x49C9, 0x49C9, 0x49C9, 0x48D1, 0x68D1,
+	0x68D1, 0x68D1, 0x87D1, 0x87D1, 0x87D9, 0x87D9, 0xA6D9, 0xA6D9,
+	0xA6D9, 0xC5E1, 0xC5E1, 0xC5E1, 0xE5E1, 0xE4E1, 0xE4E1, 0x04E2,
+	0x04EA, 0x24EA, 0x24EA, 0x44EA, 0x44EA, 0x44EA, 0x64EA, 0x64EA,
+	0x83EA, 0x83EA, 0xA3EA, 0xA3EA, 0xC3EA, 0xC3EA, 0xC3EA, 0xE3EA,
+	0xE3F2, 0x03F3, 0x02F3, 0x22F3, 0x22F3, 0x42F3, 0x42F3, 0x42F3,
+	0x62F3, 0x62F3, 0x82F3, 0x82F3, 0xA1F3, 0xA1F3, 0xC1F3, 0xC1F3,
+	0xC1FB, 0xE1FB, 0xE1FB, 0x01FC, 0x01FC, 0x21FC, 0x20FC, 0x20FC,
+	0x40FC, 0x40FC, 0x60FC, 0x60FC, 0x80FC, 0x80FC, 0xA0FC, 0xA0FC,
+	0xA0FC, 0xC0FC, 0xC0FC, 0xE0FC, 0xE0FC, 0x01FD, 0x01FD, 0x21FD,
+	0x21FD, 0x41FD, 0x42FD, 0x62FD, 0x62FD, 0x62FD, 0x82FD, 0x83FD,
+	0xA3FD, 0xA3FD, 0xC3FD, 0xC3FD, 0xE4FD, 0xE4FD, 0x04FE, 0x04FE,
+	0x04FE, 0x25FE, 0x25FE, 0x45FE, 0x45FE, 0x65FE, 0x66FE, 0x86FE,
+	0x86FE, 0xA6FE, 0xA6FE, 0xA7FE, 0xC7FE, 0xC7FE, 0xE8FE, 0xE8FE,
+	0xE9FE, 0x0AFF, 0x0BFF, 0x2CFF, 0x2DFF, 0x2EFF, 0x4FFF, 0x50FF,
+	0x51FF, 0x72FF, 0x73FF, 0x74FF, 0x95FF, 0x96FF, 0x97FF, 0xB8FF,
+	0xB9FF, 0xBAFF, 0xDBFF, 0xDCFF, 0xDDFF, 0xFEFF, 0xFEFF, 0xFFFF,
+};
+
+/* rainbow - hue from blue to red at full saturation */
+const uint16_t pal_rainbow[256] =
+{
+	0x1F00, 0x3F00, 0x5F00, 0x7F00, 0x9F00, 0xBF00, 0xDF00, 0xFF00,
+	0x1F01, 0x3F01, 0x5F01, 0x7F01, 0x9F01, 0xBF01, 0xDF01, 0xFF01,
+	0x1F02, 0x3F02, 0x5F02, 0x7F02, 0x9F02, 0xBF02, 0xDF02, 0xFF02,
+	0x1F03, 0x3F03, 0x5F03, 0x7F03, 0x9F03, 0xBF03, 0xDF03, 0xFF03,
+	0x1F04, 0x3F04, 0x5F04, 0x7F04, 0x9F04, 0xBF04, 0xDF04, 0xFF04,
+	0x1F05, 0x3F05, 0x5F05, 0x7F05, 0x9F05, 0xBF05, 0xDF05, 0xFF05,
+	0x1F06, 0x3F06, 0x5F06, 0x7F06, 0x9F06, 0xBF06, 0xDF06, 0xFF06,
+	0x1F07, 0x3F07, 0x5F07, 0x7F07, 0x9F07, 0xBF07, 0xDF07, 0xFF07,
+	0xFF07, 0xFF07, 0xFE07, 0xFE07, 0xFD07, 0xFD07, 0xFC07, 0xFC07,
+	0xFB07, 0xFB07, 0xFA07, 0xFA07, 0xF907, 0xF907, 0xF807, 0xF807,
+	0xF707, 0xF707, 0xF607, 0xF607, 0xF507, 0xF507, 0xF407, 0xF407,
+	0xF307, 0xF307, 0xF207, 0xF207, 0xF107, 0xF107, 0xF007, 0xF007,
+	0xEF07, 0xEF07, 0xEE07, 0xEE07, 0xED07, 0xED07, 0xEC07, 0xEC07,
+	0xEB07, 0xEB07, 0xEA07, 0xEA07, 0xE907, 0xE907, 0xE807, 0xE807,
+	0xE707, 0xE707, 0xE607, 0xE607, 0xE507, 0xE507, 0xE407, 0xE407,
+	0xE307, 0xE307, 0xE207, 0xE207, 0xE107, 0xE107, 0xE007, 0xE007,
+	0xE007, 0xE007, 0xE00F, 0xE00F, 0xE017, 0xE017, 0xE01F, 0xE01F,
+	0xE027, 0xE027, 0xE02F, 0xE02F, 0xE037, 0xE037, 0xE03F, 0xE03F,
+	0xE047, 0xE047, 0xE04F, 0xE04F, 0xE057, 0xE057, 0xE05F, 0xE05F,
+	0xE067, 0xE067, 0xE06F, 0xE06F, 0xE077, 0xE077, 0xE07F, 0xE07F,
+	0xE087, 0xE087, 0xE08F, 0xE08F, 0xE097, 0xE097, 0xE09F, 0xE09F,
+	0xE0A7, 0xE0A7, 0xE0AF, 0xE0AF, 0xE0B7, 0xE0B7, 0xE0BF, 0xE0BF,
+	0xE0C7, 0xE0C7, 0xE0CF, 0xE0CF, 0xE0D7, 0xE0D7, 0xE0DF, 0xE0DF,
+	0xE0E7, 0xE0E7, 0xE0EF, 0xE0EF, 0xE0F7, 0xE0F7, 0xE0FF, 0xE0FF,
+	0xE0FF, 0xC0FF, 0xA0FF, 0x80FF, 0x60FF, 0x40FF, 0x20FF, 0x00FF,
+	0xE0FE, 0xC0FE, 0xA0FE, 0x80FE, 0x60FE, 0x40FE, 0x20FE, 0x00FE,
+	0xE0FD, 0xC0FD, 0xA0FD, 0x80FD, 0x60FD, 0x40FD, 0x20FD, 0x00FD,
+	0xE0FC, 0xC0FC, 0xA0FC, 0x80FC, 0x60FC, 0x40FC, 0x20FC, 0x00FC,
+	0xE0FB, 0xC0FB, 0xA0FB, 0x80FB, 0x60FB, 0x40FB, 0x20FB, 0x00FB,
+	0xE0FA, 0xC0FA, 0xA0FA, 0x80FA, 0x60FA, 0x40FA, 0x20FA, 0x00FA,
+	0xE0F9, 0xC0F9, 0xA0F9, 0x80F9, 0x60F9, 0x40F9, 0x20F9, 0x00F9,
+	0xE0F8, 0xC0F8, 0xA0F8, 0x80F8, 0x60F8, 0x40F8, 0x20F8, 0x00F8,
+};
+
+uint16_t pal_ramp[64];				// ramp in use, 4 scale steps per entry
+const uint16_t *pal_map;			// table for the current palette
+uint8_t pal_shift;					// scale to table index
+
+/*
+ * choose the palette
+ */
+void pal_select(uint8_t p)
+{
+	uint16_t c;
+	uint8_t i;
+
+	if(p >= PAL_IRON)
+	{
+		pal_map = p == PAL_IRON ? pal_iron : pal_rainbow;
+		pal_shift = 0;
+		return;
+	}
+
+	/* green has a bit more than red & blue */
+	for(i=0;i<64;i++)
+	{
+		if(p == PAL_RED)
+			c = (i>>1) << 11;
+		else if(p == PAL_GREEN)
+			c = i << 5;
+		else if(p == PAL_BLUE)
+			c = i >> 1;
+		else
+			c = ((i>>1) << 11) | (i << 5) | (i >> 1);
+		pal_ramp[i] = (c >> 8) | (c << 8);
+	}
+	pal_map = pal_ramp;
+	pal_shift = 2;
+}
+
+/*
+ * native color of a 0-255 color scale value
+ */
+static inline uint16_t pal_color(uint8_t scale)
+{
+	return pal_map[scale >> pal_shift];
+}
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * power.h - single-file header for sensor power duty-cycling
+ * 10-19-26 E. Brombaugh
+ *
+ * Activity is the count of elements that changed by more than POWER_DELTA
+ * since the previous frame, gathered as rows are prepared. A still scene
+ * drops the sensor to 1 Hz and a long still spell puts it to sleep; motion
+ * or a button brings back 10 Hz. Waking from sleep follows the sensor's
+ * settling rules - 50 ms after normal mode, an initial reset, then the
+ * first two frames are thrown away.
+ */
+
+#ifndef __power__
+#define __power__
+
+#include "lcd.h"
+#include "amg8833.h"
+#include "sched.h"
+
+#define POWER_DELTA 4			// raw units (1C) of change that count as motion
+#define POWER_MOVING 2			// elements moving for the frame to count
+#define POWER_SLOW_FRAMES 100	// still frames at 10Hz before 1Hz
+#define POWER_SLEEP_FRAMES 60	// still frames at 1Hz before sleep
+#define POWER_DISCARD 2			// frames to drop after waking
+
+// sensor frame periods in ms
+#define POWER_FULL_PERIOD 100
+#define POWER_SLOW_PERIOD 1000
+
+enum power_states
+{
+	PWR_FULL,
+	PWR_SLOW,
+	PWR_SLEEP,
+};
+
+uint8_t power_state, power_activity, power_discard;
+uint16_t power_still;
+uint8_t power_prev[64];		// low byte of last raw value, enough for a difference
+AMG8833_DEV *power_dev;		// sensor being duty-cycled
+
+/*
+ * start dev at full rate
+ */
+void power_init(AMG8833_DEV *dev)
+{
+	power_dev = dev;
+	power_state = PWR_FULL;
+	power_activity = 0;
+	power_discard = 0;
+	power_still = 0;
+}
+
+/*
+ * compare one raw element with its value in the previous frame
+ */
+static inline void power_update(uint8_t i, int16_t ir)
+{
+	int8_t diff = (uint8_t)ir - power_prev[i];
+
+	power_prev[i] = ir;
+	if((diff > POWER_DELTA) || (diff < -POWER_DELTA))
+		power_activity++;
+}
+
+/*
+ * move the sensor to a new power state
+ */
+void power_set(uint8_t state)
+{
+	if(state == power_state)
+		return;
+
+	switch(state)
+	{
+		case PWR_FULL:
+			if(power_state == PWR_SLEEP)
+			{
+				/* wake & let it settle */
+				amg8833_reg_set(power_dev, AMG8833_PCLT, AMG8833_PCLT_NORM);
+				Delay_Ms(50);
+				amg8833_reg_set(power_dev, AMG8833_RST, AMG8833_RST_INIT);
+				Delay_Ms(2);
+				power_discard = POWER_DISCARD;
+				lcd_bkl(1);
+			}
+			amg8833_reg_set(power_dev, AMG8833_FPSC, AMG8833_FPSC_10HZ);
+			sched_resync(POWER_FULL_PERIOD);
+			break;
+
+		case PWR_SLOW:
+			amg8833_reg_set(power_dev, AMG8833_FPSC, AMG8833_FPSC_1HZ);
+			sched_resync(POWER_SLOW_PERIOD);
+			break;
+
+		case PWR_SLEEP:
+			amg8833_reg_set(power_dev, AMG8833_PCLT, AMG8833_PCLT_SLEEP);
+			lcd_bkl(0);
+			break;
+	}
+	power_state = state;
+	power_still = 0;
+}
+
+/*
+ * a button restarts the still count & brings back full rate - returns TRUE
+ * if the sensor was asleep and its settings have to be restored
+ */
+uint8_t power_wake(void)
+{
+	uint8_t slept = (power_state == PWR_SLEEP);
+
+	power_set(PWR_FULL);
+	power_still = 0;
+	return slept;
+}
+
+/*
+ * apply the policy after a frame's activity is in - auto off holds full rate
+ */
+void power_frame_done(uint8_t enable)
+{
+	if(!enable)
+		power_set(PWR_FULL);
+	else if(power_activity >= POWER_MOVING)
+	{
+		power_still = 0;
+		power_set(PWR_FULL);
+	}
+	else if(++power_still >= ((power_state == PWR_FULL) ?
+		POWER_SLOW_FRAMES : POWER_SLEEP_FRAMES))
+		power_set(power_state+1);
+
+	power_activity = 0;
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * presence.h - single-file header for presence detection & people counting
+ * 10-19-26 E. Brombaugh
+ *
+ * Each element keeps a slow running average of the scene as background and
+ * a running mean absolute deviation as its spread - standing in for the
+ * variance - both in fixed point and updated with shifts, so the model
+ * needs no multiplies. Elements standing
+ * well outside their spread are foreground; those are grouped into 4-way
+ * connected blobs and each blob's centroid is matched to the nearest one of
+ * the previous frame to count crossings of a vertical line through the
+ * middle of the image.
+ */
+
+#ifndef __presence__
+#define __presence__
+
+#define PRES_FRAC 4				// fraction bits in background & spread
+#define PRES_RATE 6				// background follows over ~2^n frames
+#define PRES_HOLD 3				// extra shift while an element is foreground
+#define PRES_LEARN 16			// frames to learn before detecting
+#define PRES_MIN (3<<PRES_FRAC)	// smallest foreground step, raw units
+#define PRES_K 2				// foreground beyond 2^n spreads
+#define PRES_BLOB_MIN 2			// elements in the smallest blob
+#define PRES_BLOBS 4			// most blobs tracked
+#define PRES_MATCH (2<<PRES_FRAC)	// furthest a blob moves between frames
+#define PRES_LINE ((7<<PRES_FRAC)/2)	// counting line between columns 3 & 4
+
+typedef struct
+{
+	int16_t x, y;				// centroid in elements, PRES_FRAC bits
+	uint8_t n;					// elements in the blob
+} PRES_BLOB;
+
+/*
+ * the background, with PRES_FRAC fraction bits, lives in the offset capture
+ * sums, which are only in use during a capture - starting one makes the
+ * detector learn again
+ */
+int16_t *const pres_bg = nuc_acc;
+uint8_t pres_dev[64];			// mean absolute deviation, PRES_FRAC bits
+PRES_BLOB pres_blobs[PRES_BLOBS], pres_prev[PRES_BLOBS];
+uint8_t pres_num, pres_prev_num, pres_learn;
+uint16_t pres_in, pres_out;
+
+/*
+ * forget the background & counts
+ */
+void pres_init(void)
+{
+	pres_learn = PRES_LEARN;
+	pres_num = pres_prev_num = 0;
+	pres_in = pres_out = 0;
+}
+
+/*
+ * update the background model with a frame & mark the foreground elements
+ * in label with 0xff
+ */
+void pres_model(int16_t *ir, uint8_t *label)
+{
+	int16_t v, d, ad, thr;
+	uint8_t i, rate;
+
+	for(i=0;i<64;i++)
+	{
+		v = ir[i] << PRES_FRAC;
+
+		/* first frame seeds the background */
+		if(pres_learn == PRES_LEARN)
+		{
+			pres_bg[i] = v;
+			pres_dev[i] = PRES_MIN >> PRES_K;
+		}
+
+		d = v - pres_bg[i];
+		ad = d < 0 ? -d : d;
+		thr = pres_dev[i] << PRES_K;
+		thr = thr < PRES_MIN ? PRES_MIN : thr;
+		label[i] = (!pres_learn && (ad > thr)) ? 0xff : 0;
+
+		/* foreground soaks into the background much more slowly */
+		rate = pres_learn ? 2 : PRES_RATE;
+		rate += label[i] ? PRES_HOLD : 0;
+		pres_bg[i] += d >> rate;
+		ad = pres_dev[i] + ((ad - pres_dev[i]) >> rate);
+		pres_dev[i] = ad > 255 ? 255 : ad;
+	}
+
+	if(pres_learn)
+		pres_learn--;
+}
+
+/*
+ * label the blob of foreground elements connected to element i
+ */
+void pres_fill(uint8_t *label, uint8_t i, uint8_t n, PRES_BLOB *blob)
+{
+	uint8_t stack[64], sp = 0, x, y;
+	int16_t sx = 0, sy = 0;
+
+	label[i] = n;
+	stack[sp++] = i;
+	blob->n = 0;
+	while(sp)
+	{
+		i = stack[--sp];
+		x = i & 7;
+		y = i >> 3;
+		sx += x;
+		sy += y;
+		blob->n++;
+
+		/* push unlabeled foreground neighbors */
+		if((x > 0) && (label[i-1] == 0xff))
+		{
+			label[i-1] = n;
+			stack[sp++] = i-1;
+		}
+		if((x < 7) && (label[i+1] == 0xff))
+		{
+			label[i+1] = n;
+			stack[sp++] = i+1;
+		}
+		if((y > 0) && (label[i-8] == 0xff))
+		{
+			label[i-8] = n;
+			stack[sp++] = i-8;
+		}
+		if((y < 7) && (label[i+8] == 0xff))
+		{
+			label[i+8] = n;
+			stack[sp++] = i+8;
+		}
+	}
+
+	blob->x = (sx << PRES_FRAC) / blob->n;
+	blob->y = (sy << PRES_FRAC) / blob->n;
+}
+
+/*
+ * group the foreground into blobs - small ones are dropped back to 0
+ */
+void pres_blobs_find(uint8_t *label)
+{
+	PRES_BLOB spare, *blob;
+	uint8_t i, j;
+
+	pres_num = 0;
+	for(i=0;i<64;i++)
+		if(label[i] == 0xff)
+		{
+			blob = pres_num < PRES_BLOBS ? &pres_blobs[pres_num] : &spare;
+			pres_fill(label, i, pres_num+1, blob);
+			if((blob != &spare) && (blob->n >= PRES_BLOB_MIN))
+			{
+				pres_num++;
+				continue;
+			}
+
+			/* too small or one too many - the rest of it lies past i */
+			for(j=i;j<64;j++)
+				if(label[j] == pres_num+1)
+					label[j] = 0;
+		}
+}
+
+/*
+ * count blobs that crossed the line since the previous frame
+ */
+void pres_count(void)
+{
+	int16_t d, best;
+	uint8_t i, j, k;
+
+	for(i=0;i<pres_num;i++)
+	{
+		/* nearest blob of the previous frame */
+		best = PRES_MATCH;
+		k = PRES_BLOBS;
+		for(j=0;j<pres_prev_num;j++)
+		{
+			d = pres_blobs[i].x - pres_prev[j].x;
+			d = d < 0 ? -d : d;
+			d += pres_blobs[i].y > pres_prev[j].y ?
+				pres_blobs[i].y - pres_prev[j].y : pres_prev[j].y - pres_blobs[i].y;
+			if(d < best)
+			{
+				best = d;
+				k = j;
+			}
+		}
+		if(k == PRES_BLOBS)
+			continue;
+
+		/* left to right is in, right to left is out */
+		if((pres_prev[k].x < PRES_LINE) && (pres_blobs[i].x >= PRES_LINE))
+			pres_in++;
+		else if((pres_prev[k].x >= PRES_LINE) && (pres_blobs[i].x < PRES_LINE))
+			pres_out++;
+	}
+
+	memcpy(pres_prev, pres_blobs, sizeof(pres_blobs));
+	pres_prev_num = pres_num;
+}
+
+/*
+ * run the detector on a frame - returns 1 if the counts changed
+ */
+uint8_t pres_frame(int16_t *ir)
+{
+	uint16_t in = pres_in, out = pres_out;
+	uint8_t label[64], num = pres_num;		// blob of each element
+
+	pres_model(ir, label);
+	pres_blobs_find(label);
+	pres_count();
+
+	return (in != pres_in) || (out != pres_out) || (num != pres_num);
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * roi.h - single-file header for the spot meter region of interest
+ * 10-19-26 E. Brombaugh
+ *
+ * A square of elements whose min, max & mean are gathered from each row of
+ * the square as it's prepared, so they cost a compare or two per element
+ * inside it and one divide per frame.
+ */
+
+#ifndef __roi__
+#define __roi__
+
+#define ROI_MAX 4			// largest side in elements
+
+uint8_t roi_x, roi_y, roi_size;		// top left element & side
+int16_t roi_min, roi_max, roi_mean;
+int32_t roi_sum;
+
+/*
+ * place the region - clamped to the array
+ */
+void roi_set(int8_t x, int8_t y, uint8_t size)
+{
+	size = size < 1 ? 1 : size;
+	size = size > ROI_MAX ? ROI_MAX : size;
+	x = x < 0 ? 0 : x;
+	x = x > 8-size ? 8-size : x;
+	y = y < 0 ? 0 : y;
+	y = y > 8-size ? 8-size : y;
+	roi_x = x;
+	roi_y = y;
+	roi_size = size;
+}
+
+/*
+ * start at the center element
+ */
+void roi_init(void)
+{
+	roi_set(3, 3, 1);
+	roi_min = roi_max = roi_mean = 0;
+}
+
+/*
+ * start gathering the region of a frame
+ */
+void roi_start(void)
+{
+	roi_min = 0x7fff;
+	roi_max = -0x8000;
+	roi_sum = 0;
+}
+
+/*
+ * gather the part of the region in rows first to first+n-1
+ */
+void roi_rows(int16_t *ir, uint8_t first, uint8_t n)
+{
+	int16_t *row, v;
+	uint8_t x, y, end = first+n;
+
+	first = first < roi_y ? roi_y : first;
+	end = end > roi_y+roi_size ? roi_y+roi_size : end;
+	for(y=first,row=&ir[y*8+roi_x];y<end;y++,row+=8)
+		for(x=0;x<roi_size;x++)
+		{
+			v = row[x];
+			if(v < roi_min)
+				roi_min = v;
+			if(v > roi_max)
+				roi_max = v;
+			roi_sum += v;
+		}
+}
+
+/*
+ * finish the region of a frame
+ */
+void roi_done(void)
+{
+	roi_mean = roi_sum / (roi_size*roi_size);
+}
+
+/*
+ * stats of the region in a frame that's already here
+ */
+void roi_frame(int16_t *ir)
+{
+	roi_start();
+	roi_rows(ir, 0, 8);
+	roi_done();
+}
+
+#endif
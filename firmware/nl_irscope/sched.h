@@ -0,0 +1,128 @@
+/*
+ * sched.h - single-file header for sensor frame-locked acquisition
+ * 10-19-26 E. Brombaugh
+ *
+ * Reads are paced by systick_cnt deadlines one sensor period apart rather
+ * than by a delay after the work, so the time spent rendering doesn't add
+ * to the period. The sensor runs from its own clock so the phase is kept
+ * locked by creeping each deadline slightly early and, when that catches
+ * a frame that hasn't updated yet, retrying a little later.
+ */
+
+#ifndef __sched__
+#define __sched__
+
+#include "systick.h"
+
+#define SCHED_PULL 1		// ms each deadline creeps early
+#define SCHED_NUDGE 10		// ms to retry after catching a repeated frame
+
+uint32_t sched_deadline, sched_sum, sched_s1, sched_s2;
+uint16_t sched_period;
+
+/* statistics - 16 bits, they only need to show a trend */
+uint16_t sched_frames;		// new frames delivered
+uint16_t sched_dups;		// reads that returned the previous frame
+uint16_t sched_misses;		// whole periods lost to late reads
+uint16_t sched_late;		// ms past deadline of last read
+uint16_t sched_late_max;	// worst ms past deadline
+
+/*
+ * start pacing at period ms - first read is due now
+ */
+void sched_init(uint16_t period)
+{
+	sched_period = period;
+	sched_deadline = SysTick_goal(0);
+	sched_sum = 0;
+	sched_frames = 0;
+	sched_dups = 0;
+	sched_misses = 0;
+	sched_late = 0;
+	sched_late_max = 0;
+}
+
+/*
+ * change the period and restart pacing from now, after a pause in reads
+ */
+void sched_resync(uint16_t period)
+{
+	sched_period = period;
+	sched_deadline = SysTick_goal(0);
+}
+
+/*
+ * returns TRUE when the next read is due and notes how late it is
+ */
+uint8_t sched_due(void)
+{
+	uint32_t late;
+
+	if(SysTick_check(sched_deadline))
+		return 0;
+
+	late = systick_cnt - sched_deadline;
+	if(late >= sched_period)
+	{
+		/* lost whole periods - skip their deadlines */
+		sched_misses += late / sched_period;
+		sched_deadline += (late / sched_period) * sched_period;
+		late %= sched_period;
+	}
+	sched_late = late;
+	if(late > sched_late_max)
+		sched_late_max = late;
+	return 1;
+}
+
+/*
+ * nothing was read this period - next read is due a period on
+ */
+void sched_skip(void)
+{
+	sched_deadline += sched_period;
+}
+
+/*
+ * start checking a frame that arrives in pieces
+ */
+void sched_sum_start(void)
+{
+	sched_s1 = 0;
+	sched_s2 = 0;
+}
+
+/*
+ * add the next n raw elements of the frame to the check
+ */
+void sched_sum_add(uint16_t *raw, uint8_t n)
+{
+	/* position-weighted sum so frames that only trade noise still differ */
+	while(n--)
+	{
+		sched_s1 += *raw++;
+		sched_s2 += sched_s1;
+	}
+}
+
+/*
+ * account for a completely checked frame - returns TRUE if it is new
+ */
+uint8_t sched_frame_done(void)
+{
+	uint32_t sum = (sched_s2<<16) ^ sched_s1;
+
+	if(sum == sched_sum)
+	{
+		/* sensor hasn't updated yet - phase is early */
+		sched_dups++;
+		sched_deadline += SCHED_NUDGE;
+		return 0;
+	}
+	sched_sum = sum;
+	sched_frames++;
+	sched_deadline += sched_period - SCHED_PULL;
+	return 1;
+}
+
+#endif
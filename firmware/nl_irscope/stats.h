@@ -0,0 +1,84 @@
+/*
+ * stats.h - single-file header for fused frame statistics
+ * 10-19-26 E. Brombaugh
+ *
+ * Min, max, their positions and the sum come out of one
+ * walk over each element as rows of a frame are prepared, for everything
+ * downstream to share instead of walking the frame again. The loop keeps
+ * its running values in registers and only compares, adds and shifts, so
+ * it suits the RV32EC's lack of a multiplier. With 64 elements the mean is
+ * a shift.
+ */
+
+#ifndef __stats__
+#define __stats__
+
+typedef struct
+{
+	int16_t min, max, mean;
+	uint8_t argmin, argmax;		// first element at each extreme
+	int32_t sum;
+} FSTATS;
+
+FSTATS ir_stats;
+
+/*
+ * start gathering a frame
+ */
+void stats_start(FSTATS *s)
+{
+	s->min = 0x7fff;
+	s->max = -0x8000;
+	s->argmin = s->argmax = 0;
+	s->sum = 0;
+}
+
+/*
+ * gather elements first to first+n-1
+ */
+void stats_elems(FSTATS *s, int16_t *ir, uint8_t first, uint8_t n)
+{
+	int16_t min = s->min, max = s->max, v;
+	int32_t sum = s->sum;
+	uint8_t i, end = first+n;
+
+	for(i=first;i<end;i++)
+	{
+		v = ir[i];
+		sum += v;
+		if(v < min)
+		{
+			min = v;
+			s->argmin = i;
+		}
+		if(v > max)
+		{
+			max = v;
+			s->argmax = i;
+		}
+	}
+
+	s->min = min;
+	s->max = max;
+	s->sum = sum;
+}
+
+/*
+ * finish a frame
+ */
+void stats_done(FSTATS *s)
+{
+	s->mean = s->sum >> 6;
+}
+
+/*
+ * gather a whole frame that's already here
+ */
+void stats_frame(FSTATS *s, int16_t *ir)
+{
+	stats_start(s);
+	stats_elems(s, ir, 0, 64);
+	stats_done(s);
+}
+
+#endif
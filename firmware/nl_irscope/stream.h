@@ -0,0 +1,145 @@
+/*
+ * stream.h - single-file header for binary frame streaming on the debug port
+ * 10-19-26 E. Brombaugh
+ *
+ * Raw frames are packed into a packet as their rows arrive and handed to
+ * the debugger a chunk at a time through the same DMDATA0/1 mailbox that
+ * printf uses, but only when the host has taken the previous chunk, so the
+ * render loop never waits on it. A frame that comes in while a packet is
+ * still going out is skipped, which shows as a gap in the sequence.
+ *
+ * Packet, multi-byte fields little-endian:
+ *   'I' 'R'    sync
+ *   seq        16 bits
+ *   therm      16 bits, raw thermistor register
+ *   pixels     96 bytes, 64 12-bit elements in pairs packed into 3 bytes
+ *   crc        16 bits, CRC-16/CCITT-FALSE over seq through pixels
+ */
+
+#ifndef __stream__
+#define __stream__
+
+#define STREAM_PIX 6				// offset of the pixels in a packet
+#define STREAM_CRC (STREAM_PIX+96)
+#define STREAM_LEN (STREAM_CRC+2)
+#define STREAM_CHUNK 7				// most bytes the mailbox carries
+
+enum stream_states
+{
+	STREAM_IDLE,
+	STREAM_FILL,
+	STREAM_SEND,
+};
+
+uint8_t stream_buf[STREAM_LEN];
+uint8_t stream_state, stream_pos;
+uint16_t stream_seq;
+
+/*
+ * start from sequence 0
+ */
+void stream_init(void)
+{
+	stream_state = STREAM_IDLE;
+	stream_seq = 0;
+}
+
+/*
+ * start filling a packet for a new read unless the last is still going out
+ */
+void stream_start(void)
+{
+	if(stream_state != STREAM_SEND)
+		stream_state = STREAM_FILL;
+}
+
+/*
+ * pack 8 raw elements of a row as they arrive
+ */
+void stream_row(uint8_t row, uint16_t *raw)
+{
+	uint8_t *p = &stream_buf[STREAM_PIX + row*12], i;
+
+	if(stream_state != STREAM_FILL)
+		return;
+
+	for(i=0;i<8;i+=2)
+	{
+		*p++ = raw[i];
+		*p++ = ((raw[i] >> 8) & 0x0f) | (raw[i+1] << 4);
+		*p++ = raw[i+1] >> 4;
+	}
+}
+
+/*
+ * CRC-16/CCITT-FALSE, bitwise - the packet only goes out at frame rate
+ */
+uint16_t stream_crc(uint8_t *buf, uint8_t len)
+{
+	uint16_t crc = 0xffff;
+	uint8_t i;
+
+	while(len--)
+	{
+		crc ^= *buf++ << 8;
+		for(i=0;i<8;i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+/*
+ * finish the packet for a new frame & queue it - a frame that couldn't be
+ * packed still takes a seq so the gap shows on the host
+ */
+void stream_finish(uint16_t therm)
+{
+	uint16_t crc;
+
+	if(stream_state != STREAM_FILL)
+	{
+		stream_seq++;
+		return;
+	}
+
+	stream_buf[0] = 'I';
+	stream_buf[1] = 'R';
+	stream_buf[2] = stream_seq;
+	stream_buf[3] = stream_seq >> 8;
+	stream_buf[4] = therm;
+	stream_buf[5] = therm >> 8;
+	crc = stream_crc(&stream_buf[2], STREAM_CRC-2);
+	stream_buf[STREAM_CRC] = crc;
+	stream_buf[STREAM_CRC+1] = crc >> 8;
+
+	stream_seq++;
+	stream_pos = 0;
+	stream_state = STREAM_SEND;
+}
+
+/*
+ * hand the host the next chunk if it has taken the last one - same layout
+ * as the debug printf: length | 0x80 & 3 bytes in DMDATA0, 4 in DMDATA1
+ */
+void stream_poll(void)
+{
+	uint8_t chunk[8] = {0}, n, i;
+
+	if((stream_state != STREAM_SEND) || (*DMDATA0 & 0x80))
+		return;
+
+	n = STREAM_LEN - stream_pos;
+	n = n > STREAM_CHUNK ? STREAM_CHUNK : n;
+	for(i=0;i<n;i++)
+		chunk[i+1] = stream_buf[stream_pos+i];
+	chunk[0] = 0x80 | (n + 4);
+
+	*DMDATA1 = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | (chunk[7] << 24);
+	*DMDATA0 = chunk[0] | (chunk[1] << 8) | (chunk[2] << 16) | (chunk[3] << 24);
+
+	stream_pos += n;
+	if(stream_pos >= STREAM_LEN)
+		stream_state = STREAM_IDLE;
+}
+
+#endif
@@ -159,6 +159,35 @@ uint8_t SysTick_get_button(uint8_t btn)
 	return result;
 }
 
+/*
+ * return TRUE until us microseconds have passed since start, a sample of
+ * SysTick->CNT which runs at the core clock
+ */
+uint8_t SysTick_us_check(uint32_t start, uint32_t us)
+{
+	return (SysTick->CNT - start) < us*(FUNCONF_SYSTEM_CORE_CLOCK/1000000);
+}
+
+/*
+ * return TRUE while any button is held, leaves edges for SysTick_get_button
+ */
+uint8_t SysTick_any_button(void)
+{
+	for(int i=0;i<NUM_BTNS;i++)
+		if(dbs[i].state)
+			return 1;
+	return 0;
+}
+
+/*
+ * forget button presses not yet collected
+ */
+void SysTick_clr_buttons(void)
+{
+	for(int i=0;i<NUM_BTNS;i++)
+		dbs[i].re = 0;
+}
+
 /*
  * compute goal for Systick counter based on desired delay in ticks
  */
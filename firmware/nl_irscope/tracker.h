@@ -0,0 +1,86 @@
+/*
+ * tracker.h - single-file header for hot & cold spot tracking
+ * 10-19-26 E. Brombaugh
+ *
+ * The extreme elements of a frame are refined to a sub-element position by
+ * the centroid of their 3x3 neighborhood, each neighbor weighted by how far
+ * it stands beyond the opposite extreme of the neighborhood. Offsets are
+ * only -1, 0 or 1 so the sums need no multiplies, leaving one divide per
+ * axis per spot.
+ */
+
+#ifndef __tracker__
+#define __tracker__
+
+#include "stats.h"
+
+#define TRK_FRAC 4			// fraction bits in positions
+
+typedef struct
+{
+	int16_t val;			// raw value of the extreme element
+	uint8_t idx;			// its index in the frame
+	int16_t x, y;			// centroid in elements, TRK_FRAC fraction bits
+} TRK_SPOT;
+
+TRK_SPOT trk_hot, trk_cold;
+
+/*
+ * centroid around spot->idx - sign is 1 for hot, -1 for cold
+ */
+void trk_centroid(int16_t *ir, TRK_SPOT *spot, int8_t sign)
+{
+	int8_t ex = spot->idx & 7, ey = spot->idx >> 3, x, y;
+	int16_t v, base = sign > 0 ? spot->val : -spot->val;
+	int32_t sw = 0, swx = 0, swy = 0;
+
+	/* weights are measured from the far extreme of the neighborhood */
+	for(y=ey-1;y<=ey+1;y++)
+		for(x=ex-1;x<=ex+1;x++)
+			if((x>=0) && (x<8) && (y>=0) && (y<8))
+			{
+				v = sign > 0 ? ir[y*8+x] : -ir[y*8+x];
+				base = v < base ? v : base;
+			}
+
+	for(y=ey-1;y<=ey+1;y++)
+		for(x=ex-1;x<=ex+1;x++)
+			if((x>=0) && (x<8) && (y>=0) && (y<8))
+			{
+				v = (sign > 0 ? ir[y*8+x] : -ir[y*8+x]) - base;
+				sw += v;
+				if(x < ex)
+					swx -= v;
+				else if(x > ex)
+					swx += v;
+				if(y < ey)
+					swy -= v;
+				else if(y > ey)
+					swy += v;
+			}
+
+	/* flat neighborhood stays on the element */
+	spot->x = ex << TRK_FRAC;
+	spot->y = ey << TRK_FRAC;
+	if(sw)
+	{
+		spot->x += (swx << TRK_FRAC) / sw;
+		spot->y += (swy << TRK_FRAC) / sw;
+	}
+}
+
+/*
+ * refine the hot and cold spots of a frame from its stats
+ */
+void trk_frame(int16_t *ir, FSTATS *s)
+{
+	trk_hot.val = s->max;
+	trk_hot.idx = s->argmax;
+	trk_cold.val = s->min;
+	trk_cold.idx = s->argmin;
+
+	trk_centroid(ir, &trk_hot, 1);
+	trk_centroid(ir, &trk_cold, -1);
+}
+
+#endif